@@ -0,0 +1,269 @@
+// Benchmarks for slurmtop's hot paths
+// Usage: bench [--fixtures DIR] [--squeue FILE] [--scontrol FILE] [--pending FILE]
+//
+// Replays squeue/scontrol output through the parsers, the pending-queue parse
+// (streamed, and in parallel) and sort, the column width computation and a
+// headless draw() on a null terminal, and reports the time and heap allocations
+// per job. Every fixture is run as recorded ("small") and scaled to 10k and 100k
+// jobs by repeating its records under fresh job ids.
+//
+// The fixtures in bench/fixtures use the formats slurmtop asks for; captured output
+// can be replayed instead with the file options:
+//   --squeue    squeue -u USER -h --Format='JobID:|,Name:|,Account:|,State:|,Reason:|,TimeUsed:|,TimeLimit:|,PriorityLong:|,tres-alloc:|,UserName:|'
+//   --scontrol  scontrol show job
+//   --pending   squeue -h -t PD -o "%i %Q"
+#define SLURMTOP_NO_MAIN
+#include "../slurmtop.cpp"
+
+#include <fstream>
+#include <new>
+
+typedef std::chrono::steady_clock BenchClock;
+
+// Every heap allocation of the process is counted. Not inlined, so that GCC does not
+// pair the malloc() inside with operator delete at the call site.
+std::atomic<unsigned long> allocationCount(0);
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    allocationCount++;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+
+bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) return false;
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Call fn once per line of text, as the pipe reader does
+template <typename LineFn>
+void forEachLine(const std::string& text, LineFn fn) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t nl = text.find('\n', pos);
+        if (nl == std::string::npos) nl = text.size();
+        fn(StringView(text.data() + pos, nl - pos));
+        pos = nl + 1;
+    }
+}
+
+std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    forEachLine(text, [&lines](StringView line) {
+        if (!line.empty()) lines.push_back(line.str());
+    });
+    return lines;
+}
+
+// Repeat records (each starting with a job id) until there are count of them,
+// renumbering the id's numeric prefix so that every job stays unique. Array and
+// het suffixes ("_[1-10]", "+1") are kept.
+std::string scaleRecords(const std::vector<std::string>& records, size_t count, size_t idStart = 0) {
+    std::string out;
+    if (records.empty()) return out;
+    for (size_t i = 0; i < count; i++) {
+        const std::string& record = records[i % records.size()];
+        size_t digits = idStart;
+        while (digits < record.size() && record[digits] >= '0' && record[digits] <= '9') digits++;
+        out.append(record, 0, idStart);
+        out += std::to_string(60000000 + i);
+        out.append(record, digits, std::string::npos);
+        out += '\n';
+    }
+    return out;
+}
+
+// scontrol output split into job blocks (each starting with "JobId=")
+std::vector<std::string> splitScontrolBlocks(const std::string& text) {
+    std::vector<std::string> blocks;
+    size_t pos = text.find("JobId=");
+    while (pos != std::string::npos) {
+        size_t next = text.find("\nJobId=", pos);
+        size_t end = next == std::string::npos ? text.size() : next + 1;
+        std::string block = text.substr(pos, end - pos);
+        while (!block.empty() && block[block.size() - 1] == '\n') block.erase(block.size() - 1);
+        blocks.push_back(block + "\n");
+        pos = next == std::string::npos ? next : next + 1;
+    }
+    return blocks;
+}
+
+// Run fn repeatedly for at least minSeconds and return the best time per run
+template <typename Fn>
+double bestSeconds(Fn fn, double minSeconds = 0.3) {
+    double best = 1e30, total = 0;
+    int runs = 0;
+    while (total < minSeconds || runs < 3) {
+        BenchClock::time_point start = BenchClock::now();
+        fn();
+        double elapsed = std::chrono::duration<double>(BenchClock::now() - start).count();
+        best = std::min(best, elapsed);
+        total += elapsed;
+        runs++;
+    }
+    return best;
+}
+
+// Time fn and count its allocations; both are reported per item
+template <typename Fn>
+void measure(const char* name, const char* fixture, size_t items, Fn fn) {
+    unsigned long before = allocationCount;
+    fn();
+    unsigned long allocations = allocationCount - before;
+    double seconds = bestSeconds(fn);
+    printf("%-26s %-6s %8zu %10.1f %12.2f\n", name, fixture, items,
+           seconds * 1e9 / std::max<size_t>(items, 1), (double)allocations / std::max<size_t>(items, 1));
+}
+
+long checksum = 0;
+
+int main(int argc, char* argv[]) {
+    std::string fixtures = "bench/fixtures";
+    std::string squeuePath, scontrolPath, pendingPath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--fixtures") fixtures = argv[i + 1];
+        else if (option == "--squeue") squeuePath = argv[i + 1];
+        else if (option == "--scontrol") scontrolPath = argv[i + 1];
+        else if (option == "--pending") pendingPath = argv[i + 1];
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+    if (squeuePath.empty()) squeuePath = fixtures + "/squeue-small.txt";
+    if (scontrolPath.empty()) scontrolPath = fixtures + "/scontrol-small.txt";
+    if (pendingPath.empty()) pendingPath = fixtures + "/pending-small.txt";
+
+    std::string squeueText, scontrolText, pendingText;
+    if (!readFile(squeuePath, squeueText) || !readFile(scontrolPath, scontrolText) ||
+        !readFile(pendingPath, pendingText)) {
+        std::cerr << "Cannot read the fixtures (run from the repository root or pass --fixtures)" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> squeueLines = splitLines(squeueText);
+    std::vector<std::string> pendingLines = splitLines(pendingText);
+    std::vector<std::string> scontrolBlocks = splitScontrolBlocks(scontrolText);
+
+    // Headless UI on a null terminal, so that draw() runs all of its ncurses work
+    setenv("LINES", "50", 1);
+    setenv("COLUMNS", "160", 1);
+    FILE* nullOut = fopen("/dev/null", "w");
+    FILE* nullIn = fopen("/dev/null", "r");
+    if (!nullOut || !nullIn || !newterm("xterm", nullOut, nullIn)) {
+        std::cerr << "Cannot create a null terminal" << std::endl;
+        return 1;
+    }
+    SqueueDataSource source;
+    DataFetcher fetcher(JobSelection("bench"), source, 0);
+    SlurmData data;
+    SlurmTopUI ui(data, fetcher);
+
+    printf("%-26s %-6s %8s %10s %12s\n", "benchmark", "size", "jobs", "ns/job", "allocs/job");
+
+    const char* sizeNames[] = {"small", "10k", "100k"};
+    for (int s = 0; s < 3; s++) {
+        const char* size = sizeNames[s];
+        size_t squeueJobs = s == 0 ? squeueLines.size() : (s == 1 ? 10000 : 100000);
+        size_t scontrolJobs = s == 0 ? scontrolBlocks.size() : squeueJobs;
+        size_t pendingJobs = s == 0 ? pendingLines.size() : squeueJobs;
+
+        std::string squeueDump = scaleRecords(squeueLines, squeueJobs);
+        std::string pendingDump = scaleRecords(pendingLines, pendingJobs);
+        std::string scontrolDump = scaleRecords(scontrolBlocks, scontrolJobs, strlen("JobId="));
+
+        measure("parseJobFromSqueue", size, squeueJobs, [&]() {
+            forEachLine(squeueDump, [](StringView line) {
+                Job job = parseJobFromSqueue(line);
+                checksum += job.gpuCount + job.jobName.size();
+            });
+        });
+
+        // The detail pane parses one job per "scontrol show job"
+        std::vector<std::string> scontrolJobBlocks = splitScontrolBlocks(scontrolDump);
+        measure("parseJobDetails", size, scontrolJobs, [&]() {
+            for (const auto& block : scontrolJobBlocks) checksum += parseJobDetails(block).allocTres.size();
+        });
+
+        SlurmData queue;
+        measure("pending parse+sort", size, pendingJobs, [&]() {
+            queue.allPendingJobs.clear();
+            forEachLine(pendingDump, [&queue](StringView line) {
+                PendingEntry entry;
+                if (parsePendingLine(line, entry)) queue.allPendingJobs.push_back(entry);
+            });
+            queue.finishPendingQueue();
+        });
+        measure("pending parse+sort (4 thr)", size, pendingJobs, [&]() {
+            queue.allPendingJobs.clear();
+            parsePendingQueue(pendingDump, 4, queue.allPendingJobs);
+            queue.finishPendingQueue();
+        });
+
+        // The model the UI renders: every job of the squeue dump plus the queue, as an
+        // admin watching all of its owners would see it (owner column, per-user totals)
+        data.clear();
+        data.selection = JobSelection();
+        forEachLine(squeueDump, [&data](StringView line) {
+            if (!line.empty()) data.addJob(parseJobFromSqueue(line));
+        });
+        data.allPendingJobs = queue.allPendingJobs;
+        data.pendingQueueLoaded = true;
+        data.updateQueueRanks();
+        data.totalJobs = data.jobs.size();
+        data.loaded = data.complete = true;
+        data.updatedAt = BenchClock::now();
+        for (const auto& owner : data.userUsage) data.selection.users.push_back(owner.first);
+
+        std::vector<size_t> rows(data.jobs.size());
+        for (size_t i = 0; i < rows.size(); i++) rows[i] = i;
+        measure("calculateColumnWidths", size, rows.size(), [&]() {
+            int maxWidths[9];
+            ui.measureColumns(rows, SlurmTopUI::ALL, maxWidths);
+            checksum += ui.calculateColumnWidths(160, 8, maxWidths).jobName;
+        });
+
+        // A new snapshot arriving while the All view is shown, and scrolling through it
+        ui.handleKey('4');
+        measure("draw (new data)", size, data.jobs.size(), [&]() {
+            ui.dataChanged();
+            ui.draw();
+        });
+        size_t scrolls = 0;
+        measure("draw (scroll, per key)", size, 1, [&]() {
+            ui.handleKey(++scrolls % 64 < 32 ? KEY_DOWN : KEY_UP);
+            ui.draw();
+        });
+        measure("draw (Home/End, per key)", size, 1, [&]() {
+            ui.handleKey(++scrolls % 2 ? KEY_END : KEY_HOME);
+            ui.draw();
+        });
+
+        // Re-sorting by Runtime, and typing a filter one key at a time, with the
+        // focus and filter reset afterwards for the next size
+        for (int i = 0; i < 4; i++) ui.handleKey(KEY_RIGHT);
+        measure("draw (sort, per key)", size, data.jobs.size(), [&]() {
+            ui.handleKey('s');
+            ui.draw();
+        });
+        measure("draw (filter, per key)", size, data.jobs.size(), [&]() {
+            ui.handleKey('/');
+            for (const char* key = "job_2"; *key; key++) {
+                ui.handleKey(*key);
+                ui.draw();
+            }
+            ui.handleKey(27);
+        });
+        for (int i = 0; i < 4; i++) ui.handleKey(KEY_LEFT);
+        ui.handleKey('s');
+    }
+
+    printf("(checksum %ld)\n", checksum);
+    return 0;
+}
@@ -3,351 +3,3892 @@
 #include <string>
 #include <vector>
 #include <map>
-#include <sstream>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
 #include <cstdio>
 #include <algorithm>
 #include <iomanip>
 #include <memory>
 #include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <climits>
+#include <getopt.h>
+#include <functional>
+#include <cerrno>
+#include <spawn.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <pwd.h>
+#include <ctime>
+
+#ifdef HAVE_LIBSLURM
+#include <slurm/slurm.h>
+#include <slurm/slurm_errno.h>
+#endif
+
+extern char** environ;
+
+// Non-owning view of a character range, used to parse command output in place
+// without copying every line (std::string_view needs C++17)
+struct StringView {
+    const char* ptr;
+    size_t len;
+
+    StringView() : ptr(""), len(0) {}
+    StringView(const char* p, size_t n) : ptr(p), len(n) {}
+    StringView(const std::string& s) : ptr(s.data()), len(s.size()) {}
+    StringView(const char* s) : ptr(s), len(strlen(s)) {}
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    char operator[](size_t i) const { return ptr[i]; }
+    std::string str() const { return std::string(ptr, len); }
+
+    size_t find(char c, size_t pos = 0) const {
+        if (pos >= len) return std::string::npos;
+        const void* hit = memchr(ptr + pos, c, len - pos);
+        return hit ? static_cast<const char*>(hit) - ptr : std::string::npos;
+    }
+
+    StringView substr(size_t pos, size_t n = std::string::npos) const {
+        if (pos > len) pos = len;
+        return StringView(ptr + pos, std::min(n, len - pos));
+    }
+
+    bool operator==(StringView other) const {
+        return len == other.len && memcmp(ptr, other.ptr, len) == 0;
+    }
+    bool operator!=(StringView other) const { return !(*this == other); }
+
+    // Strip leading/trailing whitespace (spaces, tabs, CR, LF)
+    StringView trim() const {
+        size_t b = 0, e = len;
+        while (b < e && (ptr[b] == ' ' || ptr[b] == '\t' || ptr[b] == '\r' || ptr[b] == '\n')) b++;
+        while (e > b && (ptr[e - 1] == ' ' || ptr[e - 1] == '\t' || ptr[e - 1] == '\r' || ptr[e - 1] == '\n')) e--;
+        return StringView(ptr + b, e - b);
+    }
+};
+
+// Parse a signed decimal integer that must span the whole view
+bool parseLong(StringView text, long& value) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < text.size() && (text[i] == '-' || text[i] == '+')) negative = text[i++] == '-';
+    if (i == text.size()) return false;
+
+    long result = 0;
+    for (; i < text.size(); i++) {
+        if (text[i] < '0' || text[i] > '9') return false;
+        result = result * 10 + (text[i] - '0');
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+// Process-wide pool of deduplicated strings for low-cardinality job fields
+// (account, state, reason, GPU type). Entries are never freed, so references stay
+// valid across snapshots and threads.
+const std::string& internString(StringView text) {
+    static std::mutex mutex;
+    static std::unordered_set<std::string> pool;
+    static thread_local std::string key; // Reused lookup key, avoids an allocation per call
+
+    // Small per-thread direct-mapped cache in front of the shared pool, so that the
+    // common case (a value seen before) needs neither the lock nor a string copy
+    static thread_local const std::string* recent[256];
+    size_t slot = text.size();
+    for (size_t i = 0; i < text.size(); i++) slot = slot * 31 + static_cast<unsigned char>(text[i]);
+    slot &= 255;
+    const std::string* cached = recent[slot];
+    if (cached && cached->size() == text.size() && memcmp(cached->data(), text.data(), text.size()) == 0) {
+        return *cached;
+    }
+
+    key.assign(text.data(), text.size());
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::string& interned = *pool.insert(key).first;
+    recent[slot] = &interned;
+    return interned;
+}
+
+// Handle to an interned string: one pointer, compared by identity
+class InternedString {
+private:
+    const std::string* value;
+
+public:
+    InternedString() : value(emptyValue()) {}
+    InternedString(StringView text) : value(&internString(text)) {}
+    InternedString(const std::string& text) : value(&internString(text)) {}
+    InternedString(const char* text) : value(&internString(text)) {}
+
+    const std::string& str() const { return *value; }
+    const char* c_str() const { return value->c_str(); }
+    size_t length() const { return value->length(); }
+    bool empty() const { return value->empty(); }
+    bool operator==(const InternedString& other) const { return value == other.value; }
+    bool operator!=(const InternedString& other) const { return value != other.value; }
+
+private:
+    static const std::string* emptyValue() {
+        static const std::string* empty = &internString(StringView());
+        return empty;
+    }
+};
+
+// Special duration values for the words squeue prints instead of a time
+const long kDurationUnlimited = -1;
+const long kDurationNotSet = -2;
+const long kDurationPartitionLimit = -3;
+const long kDurationInvalid = -4;
+
+// Parse a Slurm duration: minutes, minutes:seconds, hours:minutes:seconds,
+// days-hours, days-hours:minutes or days-hours:minutes:seconds
+long parseSlurmDuration(StringView text) {
+    if (text == StringView("UNLIMITED")) return kDurationUnlimited;
+    if (text == StringView("NOT_SET")) return kDurationNotSet;
+    if (text == StringView("Partition_Limit")) return kDurationPartitionLimit;
+
+    long days = 0;
+    size_t dash = text.find('-');
+    if (dash != std::string::npos) {
+        if (!parseLong(text.substr(0, dash), days) || days < 0) return kDurationInvalid;
+        text = text.substr(dash + 1);
+    }
+
+    long parts[3];
+    int count = 0;
+    size_t pos = 0;
+    for (;;) {
+        size_t colon = text.find(':', pos);
+        if (colon == std::string::npos) colon = text.size();
+        if (count == 3 || !parseLong(text.substr(pos, colon - pos), parts[count]) || parts[count] < 0) {
+            return kDurationInvalid;
+        }
+        count++;
+        if (colon == text.size()) break;
+        pos = colon + 1;
+    }
+
+    long hours = 0, minutes = 0, seconds = 0;
+    if (dash != std::string::npos) {
+        hours = parts[0];
+        if (count > 1) minutes = parts[1];
+        if (count > 2) seconds = parts[2];
+    } else if (count == 1) {
+        minutes = parts[0];
+    } else if (count == 2) {
+        minutes = parts[0];
+        seconds = parts[1];
+    } else {
+        hours = parts[0];
+        minutes = parts[1];
+        seconds = parts[2];
+    }
+    return ((days * 24 + hours) * 60 + minutes) * 60 + seconds;
+}
+
+// Format seconds like squeue does: [days-]hours:minutes:seconds or minutes:seconds
+std::string formatSlurmDuration(long seconds) {
+    switch (seconds) {
+        case kDurationUnlimited: return "UNLIMITED";
+        case kDurationNotSet: return "NOT_SET";
+        case kDurationPartitionLimit: return "Partition_Limit";
+        case kDurationInvalid: return "INVALID";
+    }
+    if (seconds < 0) return "INVALID";
+
+    char buf[32];
+    long days = seconds / 86400, hours = (seconds / 3600) % 24, minutes = (seconds / 60) % 60, secs = seconds % 60;
+    if (days > 0) snprintf(buf, sizeof(buf), "%ld-%02ld:%02ld:%02ld", days, hours, minutes, secs);
+    else if (hours > 0) snprintf(buf, sizeof(buf), "%ld:%02ld:%02ld", hours, minutes, secs);
+    else snprintf(buf, sizeof(buf), "%ld:%02ld", minutes, secs);
+    return buf;
+}
+
+// Leading numeric part of a job id ("12345_7" -> 12345, "678+1" -> 678)
+unsigned long parseJobNumber(StringView jobId) {
+    unsigned long number = 0;
+    for (size_t i = 0; i < jobId.size() && jobId[i] >= '0' && jobId[i] <= '9'; i++) {
+        number = number * 10 + (jobId[i] - '0');
+    }
+    return number;
+}
+
+// Array or het job an array task ("12345_7", "12345_[8-100]") or het component
+// ("678+1") belongs to, or 0 for a plain job id
+unsigned long parseGroupNumber(StringView jobId) {
+    size_t i = 0;
+    while (i < jobId.size() && jobId[i] >= '0' && jobId[i] <= '9') i++;
+    if (i == 0 || i == jobId.size() || (jobId[i] != '_' && jobId[i] != '+')) return 0;
+    return parseJobNumber(jobId);
+}
+
+// Job state enum
+enum class JobState {
+    RUNNING,
+    PENDING,
+    OTHER
+};
+
+// Resources listed in a job's TRES string. GPU types are kept in a small inline
+// array, as jobs rarely use more than one: kMaxGpuTypes named types, plus one last
+// slot for "other" that the GPUs of any further types are added to.
+const int kMaxGpuTypes = 4;
+const int kGpuSlots = kMaxGpuTypes + 1;
+
+struct GpuCount {
+    InternedString type;
+    int count;
+
+    GpuCount() : count(0) {}
+};
+
+struct TresUsage {
+    int cpus;
+    long memoryMB;
+    int nodes;
+    int gpuTypes;                 // Used entries of gpus
+    GpuCount gpus[kGpuSlots];
+
+    TresUsage() : cpus(0), memoryMB(0), nodes(0), gpuTypes(0) {}
+};
+
+// Job information structure. Low-cardinality text is interned and durations are
+// kept as seconds; only the id (array/het ids are not plain numbers) and the name
+// are stored as owned strings.
+struct Job {
+    std::string jobId;
+    unsigned long jobNumber;      // Numeric part of jobId
+    unsigned long groupNumber;    // Array or het job this job is part of, 0 if none
+    std::string jobName;
+    InternedString account;
+    InternedString user;          // Owner's user name
+    InternedString state;
+    InternedString reason;
+    int gpuCount;                 // All GPUs of the job
+    InternedString gpuType;       // GPU type, or the types joined with '+'
+    TresUsage tres;
+    long runtimeSeconds;          // Time used, or one of the kDuration* values
+    long timeLimitSeconds;        // Time limit, or one of the kDuration* values
+    long priority;
+    int higherCount;              // Pending jobs in the whole queue with a higher priority
+    uint64_t sourceHash;          // Hash of the source record this job was parsed from
+    unsigned long seenGeneration; // Last refresh that listed this job
+    time_t endTime;               // Finished jobs (sacct): when the job ended, else 0
+
+    Job() : jobNumber(0), groupNumber(0), gpuCount(0), runtimeSeconds(0), timeLimitSeconds(kDurationNotSet), priority(0),
+            higherCount(0), sourceHash(0), seenGeneration(0), endTime(0) {}
+
+    JobState getState() const {
+        static const InternedString running("RUNNING"), pending("PENDING");
+        if (state == running) return JobState::RUNNING;
+        if (state == pending) return JobState::PENDING;
+        return JobState::OTHER;
+    }
+};
+
+// Entry of the global pending queue: all that is needed to rank jobs
+struct PendingEntry {
+    unsigned long jobId;
+    long priority;
+};
+
+// Sort entries by descending priority: an LSD radix sort on the priority relative
+// to the lowest one, in 11-bit digits and only as many passes as the range of
+// priorities needs (three for the usual 32-bit priorities). Only the ranks matter,
+// so there is no need for comparisons; each pass is two linear scans. buffer is
+// scratch space, kept by the caller so that its allocation is reused.
+void sortByPriority(std::vector<PendingEntry>& entries, std::vector<PendingEntry>& buffer) {
+    if (entries.size() < 2) return;
+    const int kDigitBits = 11;
+    const size_t kBuckets = size_t(1) << kDigitBits;
+    long lowest = entries[0].priority, highest = entries[0].priority;
+    for (const auto& entry : entries) {
+        lowest = std::min(lowest, entry.priority);
+        highest = std::max(highest, entry.priority);
+    }
+    unsigned long range = (unsigned long)highest - (unsigned long)lowest;
+
+    buffer.resize(entries.size());
+    size_t offsets[kBuckets];
+    for (int shift = 0; shift < 64 && (range >> shift) != 0; shift += kDigitBits) {
+        auto digit = [lowest, shift](const PendingEntry& entry) {
+            return (((unsigned long)entry.priority - (unsigned long)lowest) >> shift) & (kBuckets - 1);
+        };
+        std::fill(offsets, offsets + kBuckets, 0);
+        for (const auto& entry : entries) offsets[digit(entry)]++;
+        size_t position = 0; // Highest digit first, for descending order
+        for (size_t bucket = kBuckets; bucket-- > 0;) {
+            size_t count = offsets[bucket];
+            offsets[bucket] = position;
+            position += count;
+        }
+        for (const auto& entry : entries) buffer[offsets[digit(entry)]++] = entry;
+        entries.swap(buffer);
+    }
+}
+
+// FNV-1a hash of a byte range, used to detect records that did not change
+const uint64_t kHashSeed = 14695981039346656037ULL;
+
+uint64_t hashBytes(StringView bytes, uint64_t hash = kHashSeed) {
+    for (size_t i = 0; i < bytes.size(); i++) {
+        hash ^= static_cast<unsigned char>(bytes[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Summed CPUs and memory of a group of jobs
+struct TresTotals {
+    long cpus;
+    long memoryMB;
+
+    TresTotals() : cpus(0), memoryMB(0) {}
+
+    void add(const TresUsage& tres, int sign) {
+        cpus += sign * tres.cpus;
+        memoryMB += sign * tres.memoryMB;
+    }
+};
+
+// Adds its own lifetime to a seconds counter. steady_clock::now() is a vDSO call
+// of a few tens of nanoseconds, so timers stay compiled into release builds; they
+// are placed around whole chunks and phases, never around single lines.
+class ScopeTimer {
+private:
+    double& total;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopeTimer(double& seconds) : total(seconds), start(std::chrono::steady_clock::now()) {}
+    ~ScopeTimer() { total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+
+    ScopeTimer(const ScopeTimer&) = delete;
+    ScopeTimer& operator=(const ScopeTimer&) = delete;
+};
+
+// Where the time of one refresh went, filled in by the data source and
+// fetchSlurmData(). All times are in seconds.
+struct FetchStats {
+    unsigned long refresh;  // updateGeneration of the refresh, 0 if none was measured
+    double totalSeconds;    // The whole refresh, from spawning the commands to ranking
+    double jobsSeconds;     // Wall time of the per-user query (squeue child or RPC)
+    double queueSeconds;    // Wall time of the global queue query (squeue child or daemon)
+    uint64_t bytesRead;     // Command output that was read
+    double parseSeconds;    // Spent splitting and parsing that output
+    size_t recordsParsed;   // Job and queue records seen
+    double sortSeconds;     // Sorting the global queue and ranking the user's jobs
+    double nodesSeconds;    // Wall time of the GPU capacity query (sinfo child or RPC)
+
+    FetchStats() : refresh(0), totalSeconds(0), jobsSeconds(0), queueSeconds(0), bytesRead(0),
+                   parseSeconds(0), recordsParsed(0), sortSeconds(0), nodesSeconds(0) {}
+};
+
+// Whose jobs are shown: users and/or accounts from the command line. All of them
+// are fetched with one squeue call; given both, squeue lists the jobs that match
+// a user and an account.
+struct JobSelection {
+    std::vector<std::string> users;
+    std::vector<std::string> accounts;
+
+    JobSelection() {}
+    explicit JobSelection(const std::string& user) : users(1, user) {}
+
+    bool empty() const { return users.empty() && accounts.empty(); }
+    bool singleUser() const { return users.size() == 1 && accounts.empty(); }
+
+    static std::string join(const std::vector<std::string>& names) {
+        std::string joined;
+        for (const auto& name : names) {
+            if (!joined.empty()) joined += ',';
+            joined += name;
+        }
+        return joined;
+    }
+
+    // File name of the snapshot; just the user name for a single user
+    std::string key() const {
+        std::string key = join(users);
+        for (const auto& account : accounts) key += (key.empty() ? "account-" : ",account-") + account;
+        return key;
+    }
+
+    // For the header, e.g. "User: alice", "Users: alice,bob" or "Account: proj"
+    std::string describe() const {
+        std::string text;
+        if (!users.empty()) text = (users.size() == 1 ? "User: " : "Users: ") + join(users);
+        if (!accounts.empty()) {
+            if (!text.empty()) text += "  ";
+            text += (accounts.size() == 1 ? "Account: " : "Accounts: ") + join(accounts);
+        }
+        return text;
+    }
+
+    // squeue options that select the jobs (names are checked by the caller to
+    // contain no shell syntax)
+    std::string squeueOptions() const {
+        std::string options;
+        if (!users.empty()) options += " -u " + join(users);
+        if (!accounts.empty()) options += " -A " + join(accounts);
+        return options;
+    }
+};
+
+template <typename Key>
+void adjustCount(std::map<Key, int>& counts, const Key& key, int delta) {
+    int& count = counts[key];
+    count += delta;
+    if (count == 0) counts.erase(key);
+}
+
+// Jobs and resources of one user or one account, kept up to date together with
+// the overall counters as jobs are added and removed
+struct GroupUsage {
+    int jobs; // In any state
+    int runningJobs;
+    int pendingJobs;
+    int gpusRunning;
+    int gpusRequested;
+    TresTotals runningTres;
+    TresTotals pendingTres;
+    std::map<std::string, int> gpuTypeCount;     // GPU type -> count for running jobs
+    std::map<std::string, int> gpuTypeRequested; // GPU type -> count for pending jobs
+
+    GroupUsage() : jobs(0), runningJobs(0), pendingJobs(0), gpusRunning(0), gpusRequested(0) {}
+
+    void add(const Job& job, JobState jobState, int sign) {
+        jobs += sign;
+        if (jobState == JobState::RUNNING) {
+            runningJobs += sign;
+            gpusRunning += sign * job.gpuCount;
+            runningTres.add(job.tres, sign);
+            for (int i = 0; i < job.tres.gpuTypes; i++) {
+                adjustCount(gpuTypeCount, job.tres.gpus[i].type.str(), sign * job.tres.gpus[i].count);
+            }
+        } else if (jobState == JobState::PENDING) {
+            pendingJobs += sign;
+            gpusRequested += sign * job.gpuCount;
+            pendingTres.add(job.tres, sign);
+            for (int i = 0; i < job.tres.gpuTypes; i++) {
+                adjustCount(gpuTypeRequested, job.tres.gpus[i].type.str(), sign * job.tres.gpus[i].count);
+            }
+        }
+    }
+};
+
+// Add (sign +1) or remove (-1) a job's share of its group in groups; groups
+// without jobs are dropped
+void adjustGroup(std::map<std::string, GroupUsage>& groups, const std::string& name, const Job& job,
+                 JobState jobState, int sign) {
+    auto it = groups.find(name);
+    if (it == groups.end()) it = groups.insert(std::make_pair(name, GroupUsage())).first;
+    it->second.add(job, jobState, sign);
+    if (it->second.jobs == 0) groups.erase(it);
+}
+
+// GPUs of one type across the cluster. Allocated GPUs are counted on every node;
+// the others are idle, or unavailable on nodes that cannot start jobs.
+struct GpuCapacity {
+    int total;
+    int allocated;
+    int unavailable;
+
+    GpuCapacity() : total(0), allocated(0), unavailable(0) {}
+
+    int idle() const { return total - allocated - unavailable; }
+};
+
+// Add one node's GPUs to the per-type capacity: the total from its configured
+// GRES, the allocated ones from its GRES in use
+void addNodeCapacity(std::map<std::string, GpuCapacity>& capacity, const TresUsage& configured,
+                     const TresUsage& used, bool schedulable) {
+    for (int i = 0; i < configured.gpuTypes; i++) {
+        int inUse = 0;
+        for (int j = 0; j < used.gpuTypes; j++) {
+            if (used.gpus[j].type == configured.gpus[i].type) inUse = used.gpus[j].count;
+        }
+        inUse = std::min(inUse, configured.gpus[i].count);
+        GpuCapacity& type = capacity[configured.gpus[i].type.str()];
+        type.total += configured.gpus[i].count;
+        type.allocated += inUse;
+        if (!schedulable) type.unavailable += configured.gpus[i].count - inUse;
+    }
+}
+
+// The listed members of one array or het job: array tasks (running ones are
+// listed one by one, the pending rest as one "_[range]" record) or het components.
+// The UI's grouped mode shows them as a single row.
+struct JobGroup {
+    int jobs; // Listed members in any state
+    int runningJobs;
+    int pendingJobs;
+    int gpus; // Of all members
+    int gpusRunning;
+    int gpusRequested;
+    std::map<std::string, int> stateCounts; // State -> members
+    std::map<std::string, int> gpuTypes;    // GPU type -> GPUs of all members
+    std::map<long, int> priorities;         // Priority -> members, for the lowest and highest
+
+    JobGroup() : jobs(0), runningJobs(0), pendingJobs(0), gpus(0), gpusRunning(0), gpusRequested(0) {}
+
+    void add(const Job& job, JobState jobState, int sign) {
+        jobs += sign;
+        gpus += sign * job.gpuCount;
+        if (jobState == JobState::RUNNING) {
+            runningJobs += sign;
+            gpusRunning += sign * job.gpuCount;
+        } else if (jobState == JobState::PENDING) {
+            pendingJobs += sign;
+            gpusRequested += sign * job.gpuCount;
+        }
+        adjustCount(stateCounts, job.state.str(), sign);
+        adjustCount(priorities, job.priority, sign);
+        for (int i = 0; i < job.tres.gpuTypes; i++) {
+            adjustCount(gpuTypes, job.tres.gpus[i].type.str(), sign * job.tres.gpus[i].count);
+        }
+    }
+};
+
+// Global data structure
+struct SlurmData {
+    JobSelection selection;  // Whose jobs these are
+    std::vector<Job> jobs;
+    std::vector<PendingEntry> allPendingJobs; // All pending jobs in queue for priority comparison
+    std::vector<PendingEntry> sortBuffer;     // Scratch space of finishPendingQueue(), kept for reuse
+    int totalJobs;
+    int runningJobs;
+    int pendingJobs;
+    std::map<std::string, int> gpuTypeCount; // GPU type -> count for running jobs
+    std::map<std::string, int> gpuTypeRequested; // GPU type -> count for pending jobs
+    TresTotals runningTres;  // CPUs and memory allocated to running jobs
+    TresTotals pendingTres;  // CPUs and memory requested by pending jobs
+    std::map<std::string, GroupUsage> userUsage;    // Per job owner
+    std::map<std::string, GroupUsage> accountUsage; // Per account
+    std::unordered_map<unsigned long, JobGroup> groups; // Array and het jobs by groupNumber
+    std::map<std::string, GpuCapacity> gpuCapacity;     // Cluster-wide GPUs per type
+    bool capacityLoaded;     // gpuCapacity was fetched (the source fetches it, and sinfo worked)
+    bool loaded;             // False until the first (possibly partial) data has arrived
+    bool complete;           // False while a streaming fetch is still filling this snapshot
+    bool pendingQueueLoaded; // allPendingJobs holds the complete, sorted global queue
+    bool stale;              // Loaded from the snapshot file of an earlier run, not yet refreshed
+    std::chrono::steady_clock::time_point updatedAt; // When this snapshot was fetched
+    FetchStats stats;        // Timings of the refresh that produced this snapshot
+
+    // Incremental model state, only maintained on the fetcher's copy
+    std::unordered_map<std::string, size_t> jobIndex; // jobId -> position in jobs
+    unsigned long updateGeneration;                   // Current refresh number
+
+    SlurmData() : totalJobs(0), runningJobs(0), pendingJobs(0), capacityLoaded(false), loaded(false), complete(false),
+                  pendingQueueLoaded(false), stale(false), updateGeneration(0) {}
+
+    // Copy everything the UI renders into out, reusing out's storage. The global
+    // queue is only copied once it is complete, as a half-read queue gives
+    // meaningless ranks. The incremental index is not copied.
+    void copySnapshotTo(SlurmData& out) const {
+        out.selection = selection;
+        out.jobs = jobs;
+        if (pendingQueueLoaded) out.allPendingJobs = allPendingJobs;
+        else out.allPendingJobs.clear();
+        out.totalJobs = jobs.size();
+        out.runningJobs = runningJobs;
+        out.pendingJobs = pendingJobs;
+        out.gpuTypeCount = gpuTypeCount;
+        out.gpuTypeRequested = gpuTypeRequested;
+        out.runningTres = runningTres;
+        out.pendingTres = pendingTres;
+        out.userUsage = userUsage;
+        out.accountUsage = accountUsage;
+        out.groups = groups;
+        out.gpuCapacity = gpuCapacity;
+        out.capacityLoaded = capacityLoaded;
+        out.loaded = loaded;
+        out.complete = complete;
+        out.pendingQueueLoaded = pendingQueueLoaded;
+        out.stale = stale;
+        out.updatedAt = updatedAt;
+        out.stats = stats;
+    }
+
+    // Copy of a snapshot that is still being filled
+    SlurmData partialCopy() const {
+        SlurmData copy;
+        copySnapshotTo(copy);
+        copy.updateQueueRanks();
+        copy.loaded = true;
+        copy.complete = false;
+        copy.updatedAt = std::chrono::steady_clock::now();
+        return copy;
+    }
+
+    void clear() {
+        jobs.clear();
+        jobIndex.clear();
+        allPendingJobs.clear();
+        gpuTypeCount.clear();
+        gpuTypeRequested.clear();
+        runningTres = pendingTres = TresTotals();
+        userUsage.clear();
+        accountUsage.clear();
+        groups.clear();
+        totalJobs = runningJobs = pendingJobs = 0;
+        pendingQueueLoaded = false;
+    }
+
+    // Add or remove a job's contribution to the counters, resource totals, GPU maps,
+    // per-user and per-account usage and its array or het job, all in one go
+    void accountJob(const Job& job, int sign) {
+        JobState jobState = job.getState();
+        adjustGroup(userUsage, job.user.str(), job, jobState, sign);
+        adjustGroup(accountUsage, job.account.str(), job, jobState, sign);
+        if (job.groupNumber != 0) {
+            JobGroup& group = groups[job.groupNumber];
+            group.add(job, jobState, sign);
+            if (group.jobs == 0) groups.erase(job.groupNumber);
+        }
+        if (jobState == JobState::RUNNING) {
+            runningJobs += sign;
+            runningTres.add(job.tres, sign);
+            for (int i = 0; i < job.tres.gpuTypes; i++) {
+                adjustCount(gpuTypeCount, job.tres.gpus[i].type.str(), sign * job.tres.gpus[i].count);
+            }
+        } else if (jobState == JobState::PENDING) {
+            pendingJobs += sign;
+            pendingTres.add(job.tres, sign);
+            for (int i = 0; i < job.tres.gpuTypes; i++) {
+                adjustCount(gpuTypeRequested, job.tres.gpus[i].type.str(), sign * job.tres.gpus[i].count);
+            }
+        }
+    }
+
+    // Add one of the user's jobs and account for it in the counters and GPU maps
+    void addJob(const Job& job) {
+        jobIndex[job.jobId] = jobs.size();
+        jobs.push_back(job);
+        jobs.back().seenGeneration = updateGeneration;
+        accountJob(job, +1);
+    }
+
+    // Incremental refresh: beginUpdate() starts a refresh, updateJob() is called for
+    // every job in the new listing and endUpdate() drops jobs that were not listed.
+    void beginUpdate() {
+        updateGeneration++;
+        allPendingJobs.clear(); // The global queue is always re-read in full
+        pendingQueueLoaded = false;
+    }
+
+    // Report a job from the new listing. sourceHash identifies the record's content;
+    // parse() is only called (and the counters adjusted) if the job is new or its
+    // record changed. Returns the job if it was unchanged, so that the caller can
+    // refresh fields that are excluded from the hash, or nullptr otherwise.
+    template <typename ParseFn>
+    Job* updateJob(const std::string& jobId, uint64_t sourceHash, ParseFn parse) {
+        auto it = jobIndex.find(jobId);
+        if (it == jobIndex.end()) {
+            Job job = parse();
+            job.sourceHash = sourceHash;
+            addJob(job);
+            return nullptr;
+        }
+
+        Job& existing = jobs[it->second];
+        existing.seenGeneration = updateGeneration;
+        if (existing.sourceHash == sourceHash) return &existing;
+
+        accountJob(existing, -1);
+        existing = parse();
+        existing.sourceHash = sourceHash;
+        existing.seenGeneration = updateGeneration;
+        accountJob(existing, +1);
+        return nullptr;
+    }
+
+    void endUpdate() {
+        size_t kept = 0;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (jobs[i].seenGeneration != updateGeneration) {
+                accountJob(jobs[i], -1);
+                jobIndex.erase(jobs[i].jobId);
+                continue;
+            }
+            if (kept != i) {
+                jobs[kept] = std::move(jobs[i]);
+                jobIndex[jobs[kept].jobId] = kept;
+            }
+            kept++;
+        }
+        jobs.resize(kept);
+        totalJobs = jobs.size();
+    }
+
+    // Sort the global pending queue by priority (descending) and mark it complete
+    void finishPendingQueue() {
+        ScopeTimer timer(stats.sortSeconds);
+        sortByPriority(allPendingJobs, sortBuffer);
+        pendingQueueLoaded = true;
+    }
+
+    // Cache each job's position in the sorted global queue: the number of jobs with
+    // a strictly higher priority is the length of the prefix found by binary search
+    void updateQueueRanks() {
+        if (!pendingQueueLoaded) return;
+        ScopeTimer timer(stats.sortSeconds);
+        for (auto& job : jobs) {
+            auto firstNotHigher = std::lower_bound(allPendingJobs.begin(), allPendingJobs.end(), job.priority,
+                                                   [](const PendingEntry& queued, long p) { return queued.priority > p; });
+            job.higherCount = firstNotHigher - allPendingJobs.begin();
+        }
+    }
+};
+
+// Hard limits on the run time of a child query. A hung slurmctld or slurmdbd would
+// otherwise keep a fetch (and the data on screen) waiting forever.
+const std::chrono::seconds kCommandTimeout(30);     // squeue, sinfo, scontrol
+const std::chrono::seconds kAccountingTimeout(120); // sacct; slurmdbd is slower on long windows
+
+// Spawn "/bin/sh -c cmd" with stdout redirected into a pipe; returns the child pid or -1.
+// The child leads its own process group, so that a timeout kills the query the
+// shell started along with the shell.
+pid_t spawnCommand(const std::string& cmd, int& readFd) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) return -1;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    const char* argv[] = {"/bin/sh", "-c", cmd.c_str(), nullptr};
+    pid_t pid;
+    int rc = posix_spawn(&pid, "/bin/sh", &actions, &attributes, const_cast<char* const*>(argv), environ);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+
+    if (rc != 0) {
+        close(fds[0]);
+        return -1;
+    }
+    readFd = fds[0];
+    return pid;
+}
+
+// Process groups of the commands running right now, so that quitting does not wait
+// for a hung query to time out
+std::mutex runningCommandsMutex;
+std::unordered_set<pid_t> runningCommands;
+
+void setCommandRunning(pid_t pid, bool running) {
+    std::lock_guard<std::mutex> lock(runningCommandsMutex);
+    if (running) runningCommands.insert(pid);
+    else runningCommands.erase(pid);
+}
+
+// Kill every running command; their runCommands() calls then see them fail
+void killRunningCommands() {
+    std::lock_guard<std::mutex> lock(runningCommandsMutex);
+    for (pid_t pid : runningCommands) kill(-pid, SIGKILL);
+}
+
+// Reads a pipe in large chunks into a reusable buffer and hands out complete lines
+// as views into that buffer (valid only for the duration of the callback)
+class PipeReader {
+private:
+    std::vector<char> buffer;
+    size_t begin; // Start of the unconsumed (partial line) data
+    size_t end;   // End of valid data
+
+public:
+    static const size_t kChunkSize = 256 * 1024;
+
+    uint64_t bytesRead;   // Total read so far
+    double parseSeconds;  // Total time spent in the line callbacks
+
+    PipeReader() : buffer(kChunkSize * 2), begin(0), end(0), bytesRead(0), parseSeconds(0) {}
+
+    // Read once from fd and deliver every complete line. Returns the number of
+    // bytes read: 0 on EOF, -1 on error (errno is preserved).
+    template <typename LineFn>
+    ssize_t readSome(int fd, LineFn onLine) {
+        // Make room for a full chunk: move the partial line to the front, grow if needed
+        if (buffer.size() - end < kChunkSize) {
+            if (begin > 0) {
+                memmove(buffer.data(), buffer.data() + begin, end - begin);
+                end -= begin;
+                begin = 0;
+            }
+            if (buffer.size() - end < kChunkSize) buffer.resize(buffer.size() * 2);
+        }
+
+        ssize_t n = read(fd, buffer.data() + end, buffer.size() - end);
+        if (n <= 0) return n;
+        end += n;
+        bytesRead += n;
+
+        ScopeTimer timer(parseSeconds); // One timer per chunk, not per line
+        const char* base = buffer.data();
+        while (begin < end) {
+            const char* nl = static_cast<const char*>(memchr(base + begin, '\n', end - begin));
+            if (!nl) break;
+            size_t lineEnd = nl - base;
+            onLine(StringView(base + begin, lineEnd - begin));
+            begin = lineEnd + 1;
+        }
+        if (begin == end) begin = end = 0;
+        return n;
+    }
+
+    // Read once from fd and append the bytes to out as they are, for output that is
+    // parsed only once complete. Returns what readSome() returns.
+    ssize_t readInto(int fd, std::string& out) {
+        ssize_t n = read(fd, buffer.data(), kChunkSize);
+        if (n <= 0) return n;
+        out.append(buffer.data(), n);
+        bytesRead += n;
+        return n;
+    }
+
+    // Deliver a trailing line that had no terminating newline
+    template <typename LineFn>
+    void flush(LineFn onLine) {
+        ScopeTimer timer(parseSeconds);
+        if (end > begin) onLine(StringView(buffer.data() + begin, end - begin));
+        begin = end = 0;
+    }
+};
+
+// A shell command whose stdout is consumed line by line as it is produced
+struct CommandStream {
+    std::string cmd;
+    std::function<void(StringView)> onLine; // Called for every output line (without '\n')
+    std::function<void()> onEnd;            // Called once the command's output has ended
+    std::string* collect;                   // If set, the output is appended here instead of going to onLine
+    pid_t pid;
+    int fd;
+    int status;                             // waitpid() status once ended, -1 if it never ran
+    bool timedOut;                          // Killed for running past the timeout
+    double seconds;                         // Wall time from spawn until the child was reaped
+    PipeReader reader;
+
+    CommandStream() : collect(nullptr), pid(-1), fd(-1), status(-1), timedOut(false), seconds(0) {}
+
+    bool succeeded() const { return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0; }
+
+    // Why the command did not succeed, for messages ("timed out", "exit status 1")
+    std::string failure() const {
+        if (timedOut) return "timed out";
+        if (status == -1) return "could not be run";
+        if (WIFSIGNALED(status)) return "killed by signal " + std::to_string(WTERMSIG(status));
+        if (WEXITSTATUS(status) == 127) return "not found";
+        return "exit status " + std::to_string(WEXITSTATUS(status));
+    }
+};
+
+// Run all commands concurrently and feed each stream's lines to its callback as they
+// arrive, so the total wall time is that of the slowest command rather than the sum.
+// onProgress (optional) is called after every batch of reads. Commands still running
+// after timeout are killed (with everything they started) and marked timedOut; their
+// onEnd is not called, as their output is incomplete.
+void runCommands(std::vector<CommandStream>& streams, const std::function<void()>& onProgress = nullptr,
+                 std::chrono::seconds timeout = kCommandTimeout) {
+    typedef std::chrono::steady_clock Clock;
+    std::vector<struct pollfd> pfds;
+    std::vector<CommandStream*> active;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + timeout;
+    for (auto& stream : streams) {
+        stream.pid = spawnCommand(stream.cmd, stream.fd);
+        if (stream.pid < 0) continue;
+        setCommandRunning(stream.pid, true);
+        struct pollfd pfd = {stream.fd, POLLIN, 0};
+        pfds.push_back(pfd);
+        active.push_back(&stream);
+    }
+
+    while (!pfds.empty()) {
+        Clock::time_point now = Clock::now();
+        if (now >= deadline) {
+            for (CommandStream* stream : active) {
+                kill(-stream->pid, SIGKILL);
+                close(stream->fd);
+                stream->fd = -1;
+                setCommandRunning(stream->pid, false); // Before the pid can be reused
+                waitpid(stream->pid, &stream->status, 0);
+                stream->timedOut = true;
+                stream->seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            }
+            break;
+        }
+        int waitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+        if (poll(pfds.data(), pfds.size(), waitMs) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (size_t i = 0; i < pfds.size();) {
+            CommandStream& stream = *active[i];
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                i++;
+                continue;
+            }
+
+            ssize_t n = stream.collect ? stream.reader.readInto(stream.fd, *stream.collect)
+                                       : stream.reader.readSome(stream.fd, stream.onLine);
+            if (n > 0 || (n < 0 && errno == EINTR)) {
+                i++;
+                continue;
+            }
+
+            // EOF or error: flush the last unterminated line and reap the child
+            if (!stream.collect) stream.reader.flush(stream.onLine);
+            close(stream.fd);
+            stream.fd = -1;
+            setCommandRunning(stream.pid, false);
+            waitpid(stream.pid, &stream.status, 0);
+            stream.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            pfds.erase(pfds.begin() + i);
+            active.erase(active.begin() + i);
+            if (stream.onEnd) stream.onEnd();
+        }
+
+        if (onProgress) onProgress();
+    }
+}
+
+// Execute command and return its output. succeeded (optional) is set to whether it
+// exited with status 0 within timeout; a killed command returns what it wrote so far.
+std::string execCommand(const std::string& cmd, bool* succeeded = nullptr,
+                        std::chrono::seconds timeout = kCommandTimeout) {
+    std::string result;
+    std::vector<CommandStream> streams(1);
+    streams[0].cmd = cmd;
+    streams[0].collect = &result;
+    runCommands(streams, nullptr, timeout);
+    if (succeeded) *succeeded = streams[0].succeeded();
+    return result;
+}
+
+// True if every byte is printable ASCII. Branch-free so the compiler can vectorize
+// it; this is the fast path for nearly every field squeue prints.
+bool isPrintableAscii(StringView str) {
+    unsigned char bad = 0;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(str.data());
+    for (size_t i = 0; i < str.size(); i++) {
+        bad |= static_cast<unsigned char>(bytes[i] - 32) > 94;
+    }
+    return bad == 0;
+}
+
+// Strip control characters (newlines, tabs, etc) from string
+std::string stripControlChars(StringView str) {
+    if (isPrintableAscii(str)) return str.str();
+
+    std::string result;
+    result.reserve(str.size());
+    for (size_t i = 0; i < str.size(); i++) {
+        char c = str[i];
+        if (c >= 32 && c <= 126) {  // Only printable ASCII
+            result += c;
+        } else if (c == '\t') {
+            result += ' ';  // Replace tabs with spaces
+        }
+        // Skip all other control characters including \n, \r
+    }
+    return result;
+}
+
+// Intern a field with control characters stripped, without a temporary string
+// when the field is already clean
+InternedString internPrintable(StringView str) {
+    if (isPrintableAscii(str)) return InternedString(str);
+    return InternedString(stripControlChars(str));
+}
+
+// Single-pass tokenizer shared by the squeue and scontrol parsers. Tokens are views
+// into the input, so splitting a line allocates nothing.
+class FieldTokenizer {
+private:
+    StringView text;
+    size_t pos;
+
+public:
+    FieldTokenizer(StringView input) : text(input), pos(0) {}
+
+    bool atEnd() const { return pos >= text.size(); }
+
+    // Next token up to (not including) the separator; false once the input is used up
+    bool next(char separator, StringView& token) {
+        if (atEnd()) return false;
+        size_t sep = text.find(separator, pos);
+        if (sep == std::string::npos) sep = text.size();
+        token = text.substr(pos, sep - pos);
+        pos = sep + 1;
+        return true;
+    }
+
+    // Next whitespace-separated word, skipping runs of spaces, tabs and newlines
+    bool nextWord(StringView& word) {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) pos++;
+        if (atEnd()) return false;
+        size_t start = pos;
+        while (pos < text.size() && text[pos] != ' ' && text[pos] != '\t' && text[pos] != '\n' && text[pos] != '\r') pos++;
+        word = text.substr(start, pos - start);
+        return true;
+    }
+};
+
+// Memory amount of a TRES entry ("16G", "1.50T", "500M") in megabytes
+long parseTresMemory(StringView value) {
+    long whole = 0, fraction = 0, scale = 1;
+    size_t i = 0;
+    for (; i < value.size() && value[i] >= '0' && value[i] <= '9'; i++) whole = whole * 10 + (value[i] - '0');
+    if (i < value.size() && value[i] == '.') {
+        for (i++; i < value.size() && value[i] >= '0' && value[i] <= '9'; i++) {
+            if (scale < 1000) {
+                fraction = fraction * 10 + (value[i] - '0');
+                scale *= 10;
+            }
+        }
+    }
+    long unit = 1; // Slurm's default unit is megabytes
+    if (i < value.size()) {
+        switch (value[i]) {
+            case 'K': return whole / 1024;
+            case 'G': unit = 1024; break;
+            case 'T': unit = 1024L * 1024; break;
+            case 'P': unit = 1024L * 1024 * 1024; break;
+        }
+    }
+    return whole * unit + fraction * unit / scale;
+}
+
+// Add count GPUs of one type. Types beyond kMaxGpuTypes go to the overflow slot
+// ("other"); the types that fit keep their own counts.
+void addGpuCount(TresUsage& tres, InternedString type, int count) {
+    static const InternedString other("other");
+    for (int i = 0; i < std::min(tres.gpuTypes, kMaxGpuTypes); i++) {
+        if (tres.gpus[i].type == type) {
+            tres.gpus[i].count += count;
+            return;
+        }
+    }
+    if (tres.gpuTypes < kMaxGpuTypes) {
+        tres.gpus[tres.gpuTypes].type = type;
+        tres.gpus[tres.gpuTypes].count = count;
+        tres.gpuTypes++;
+        return;
+    }
+    GpuCount& overflow = tres.gpus[kMaxGpuTypes];
+    if (tres.gpuTypes == kMaxGpuTypes) {
+        overflow.type = other;
+        overflow.count = 0;
+        tres.gpuTypes++;
+    }
+    overflow.count += count;
+}
+
+// Parse a TRES string (cpu=8,mem=64G,node=1,billing=8,gres/gpu=3,gres/gpu:a100=2,gres/gpu:v100=1)
+// in one pass. Every typed gres/gpu entry is kept; GPUs that the untyped total
+// counts beyond the typed ones are attributed to "generic". gpuCount is the job's
+// total and gpuType names its type, or all of its types joined with '+'.
+void parseTres(StringView text, Job& job) {
+    static const InternedString notAvailable("N/A"), generic("generic");
+    TresUsage& tres = job.tres;
+    tres.cpus = tres.nodes = tres.gpuTypes = 0;
+    tres.memoryMB = 0;
+    int untypedGpus = 0, typedGpus = 0;
+
+    // Entries are split with memchr and recognised by their prefix, so entries
+    // that are not needed (billing, license, ...) cost one search each
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* entryEnd = static_cast<const char*>(memchr(p, ',', end - p));
+        if (!entryEnd) entryEnd = end;
+        StringView entry(p, entryEnd - p);
+        p = entryEnd + 1;
+        long count;
+
+        if (entry.size() > 4 && memcmp(entry.data(), "cpu=", 4) == 0) {
+            if (parseLong(entry.substr(4), count)) tres.cpus = static_cast<int>(count);
+        } else if (entry.size() > 4 && memcmp(entry.data(), "mem=", 4) == 0) {
+            tres.memoryMB = parseTresMemory(entry.substr(4));
+        } else if (entry.size() > 5 && memcmp(entry.data(), "node=", 5) == 0) {
+            if (parseLong(entry.substr(5), count)) tres.nodes = static_cast<int>(count);
+        } else if (entry.size() > 9 && memcmp(entry.data(), "gres/gpu", 8) == 0) {
+            if (entry[8] == '=') {
+                if (parseLong(entry.substr(9), count) && count > 0) untypedGpus += static_cast<int>(count);
+            } else if (entry[8] == ':') {
+                // gres/gpu:TYPE=COUNT
+                size_t eq = entry.find('=', 9);
+                if (eq == std::string::npos || eq == 9) continue;
+                if (!parseLong(entry.substr(eq + 1), count) || count <= 0) continue;
+                addGpuCount(tres, internPrintable(entry.substr(9, eq - 9)), static_cast<int>(count));
+                typedGpus += static_cast<int>(count);
+            }
+        }
+    }
+    if (untypedGpus > typedGpus) addGpuCount(tres, generic, untypedGpus - typedGpus);
+
+    job.gpuCount = std::max(untypedGpus, typedGpus);
+    if (tres.gpuTypes == 0) {
+        job.gpuType = notAvailable;
+    } else if (tres.gpuTypes == 1) {
+        job.gpuType = tres.gpus[0].type;
+    } else {
+        std::string joined = tres.gpus[0].type.str();
+        for (int i = 1; i < tres.gpuTypes; i++) joined += "+" + tres.gpus[i].type.str();
+        job.gpuType = InternedString(joined);
+    }
+}
+
+// Parse a node's GRES ("gpu:a100:4(S:0-1),shard:8") or GRES in use
+// ("gpu:a100:2(IDX:0,3)") into its GPUs per type. Commas inside parentheses do not
+// end an entry; untyped GPUs ("gpu:4") count as "generic", as in parseTres().
+void parseGres(StringView text, TresUsage& gpus) {
+    static const InternedString generic("generic");
+    gpus.gpuTypes = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = pos;
+        int depth = 0;
+        for (; end < text.size() && (depth > 0 || text[end] != ','); end++) {
+            if (text[end] == '(') depth++;
+            else if (text[end] == ')') depth--;
+        }
+        StringView entry = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t paren = entry.find('(');
+        if (paren != std::string::npos) entry = entry.substr(0, paren);
+        if (entry.size() < 5 || memcmp(entry.data(), "gpu:", 4) != 0) continue;
+
+        // gpu:COUNT or gpu:TYPE:COUNT
+        StringView rest = entry.substr(4);
+        size_t colon = rest.find(':');
+        long count;
+        if (colon == std::string::npos) {
+            if (parseLong(rest, count) && count > 0) addGpuCount(gpus, generic, static_cast<int>(count));
+        } else if (colon > 0 && parseLong(rest.substr(colon + 1), count) && count > 0) {
+            addGpuCount(gpus, internPrintable(rest.substr(0, colon)), static_cast<int>(count));
+        }
+    }
+}
+
+// Parse job from squeue pipe-delimited line
+// Format: JobID|JobName|Account|State|Reason|TimeUsed|TimeLimit|Priority|TresAlloc|UserName|
+Job parseJobFromSqueue(StringView line) {
+    Job job;
+    int fieldIndex = 0;
+    FieldTokenizer fields(line);
+    StringView token;
+
+    while (fields.next('|', token)) {
+        // Strip any leading/trailing whitespace
+        token = token.trim();
+
+        switch (fieldIndex) {
+            case 0:
+                job.jobId = stripControlChars(token);
+                job.jobNumber = parseJobNumber(job.jobId);
+                job.groupNumber = parseGroupNumber(job.jobId);
+                break;
+            case 1: job.jobName = stripControlChars(token); break;
+            case 2: job.account = internPrintable(token); break;
+            case 3: job.state = internPrintable(token); break;
+            case 4: job.reason = internPrintable(token); break;
+            case 5: job.runtimeSeconds = parseSlurmDuration(token); break;
+            case 6: job.timeLimitSeconds = parseSlurmDuration(token); break;
+            case 7:
+                if (!parseLong(token, job.priority)) job.priority = 0;
+                break;
+            case 8:
+                // Parse TRES allocation (format: cpu=4,mem=16G,gres/gpu:a100=2)
+                parseTres(token, job);
+                break;
+            case 9: job.user = internPrintable(token); break;
+        }
+        fieldIndex++;
+    }
+
+    return job;
+}
+
+// What the detail pane shows of one job, from "scontrol show job"
+struct JobDetails {
+    std::string jobId;
+    std::string state, reason, partition, qos;
+    std::string nodeList, numNodes, numCpus;
+    std::string submitTime, startTime, endTime;
+    std::string workDir, command, stdOut;
+    std::string reqTres, allocTres, dependency;
+};
+
+// Parse the first job of scontrol output (an array lists all of its tasks) into
+// its details, in one pass over the Key=Value words. "(null)" values are left empty.
+JobDetails parseJobDetails(StringView scontrolOutput) {
+    struct Field {
+        const char* key;
+        std::string JobDetails::*value;
+    };
+    static const Field fields[] = {
+        {"JobId", &JobDetails::jobId},         {"JobState", &JobDetails::state},
+        {"Reason", &JobDetails::reason},       {"Partition", &JobDetails::partition},
+        {"QOS", &JobDetails::qos},             {"NodeList", &JobDetails::nodeList},
+        {"NumNodes", &JobDetails::numNodes},   {"NumCPUs", &JobDetails::numCpus},
+        {"SubmitTime", &JobDetails::submitTime}, {"StartTime", &JobDetails::startTime},
+        {"EndTime", &JobDetails::endTime},     {"WorkDir", &JobDetails::workDir},
+        {"Command", &JobDetails::command},     {"StdOut", &JobDetails::stdOut},
+        {"ReqTRES", &JobDetails::reqTres},     {"AllocTRES", &JobDetails::allocTres},
+        {"Dependency", &JobDetails::dependency}};
+
+    JobDetails details;
+    FieldTokenizer words(scontrolOutput);
+    StringView word;
+    bool seenJob = false;
+    while (words.nextWord(word)) {
+        size_t eq = word.find('=');
+        if (eq == std::string::npos) continue;
+        StringView key = word.substr(0, eq);
+        StringView value = word.substr(eq + 1);
+        if (key == StringView("JobId")) {
+            if (seenJob) break; // The next task's record
+            seenJob = true;
+        }
+        if (value == StringView("(null)")) continue;
+        for (const Field& field : fields) {
+            if (key == StringView(field.key)) {
+                details.*field.value = stripControlChars(value);
+                break;
+            }
+        }
+    }
+    return details;
+}
+
+// Called with partially filled data while a fetch is still in progress
+typedef std::function<void(const SlurmData&)> PartialFn;
+
+// Threads that parse the global queue (--threads). By default the queue is parsed
+// on one thread while squeue writes it, which overlaps the parse with the query;
+// collecting it for a parallel parse only pays off on very large queues.
+const int kDefaultParseThreads = 1;
+const int kMaxParseThreads = 64;
+const size_t kMinParseBytesPerThread = 256 * 1024; // Smaller queues use fewer threads
+
+// The overview's cluster GPUs are asked for at most this often, not with every
+// refresh: the node listing costs slurmctld a walk over the whole node table.
+const std::chrono::seconds kCapacityInterval(30);
+
+// A backend that fills SlurmData (the user's jobs and the global pending queue).
+// fetch() returns false if the backend could not provide data, so that the caller
+// can fall back to another one; lastFailure() then says why.
+class SlurmDataSource {
+protected:
+    bool fetchCapacity;
+    int parseThreads;
+    std::string failure;
+    std::chrono::steady_clock::time_point capacityDue; // Next time the capacity is asked for
+
+    // Whether this fetch should also ask for the capacity; the next one does not
+    // until kCapacityInterval has passed (also after a failed query)
+    bool takeCapacityTurn() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!fetchCapacity || now < capacityDue) return false;
+        capacityDue = now + kCapacityInterval;
+        return true;
+    }
+
+public:
+    SlurmDataSource() : fetchCapacity(false), parseThreads(kDefaultParseThreads) {}
+    virtual ~SlurmDataSource() {}
+    virtual const char* name() const = 0;
+    virtual bool fetch(SlurmData& data, const PartialFn& onPartial) = 0;
+
+    // Also fill in the cluster's GPU capacity, every kCapacityInterval (while the
+    // overview shows it; --batch never does)
+    virtual void setFetchCapacity(bool enabled) { fetchCapacity = enabled; }
+
+    // Ask for the capacity alone if it is due (see takeCapacityTurn), between two
+    // fetch()es; true if data.gpuCapacity was updated
+    virtual bool fetchCapacityOnly(SlurmData& data) { (void)data; return false; }
+
+    // Threads for parsing the global pending queue's text (--threads)
+    virtual void setParseThreads(int threads) { parseThreads = threads; }
+
+    // Why the last fetch() failed, for the status line (e.g. "squeue timed out")
+    virtual const std::string& lastFailure() const { return failure; }
+};
+
+// Minimum time between two partial snapshots published while squeue is still writing
+const std::chrono::milliseconds kPartialPublishInterval(100);
+
+// Global pending queue: "jobid priority" for every pending job of every user
+const char* const kPendingQueueCommand = "squeue -h -t PD -o \"%i %Q\" 2>/dev/null";
+
+// Parse one line of kPendingQueueCommand output; false for malformed lines and for
+// jobs without a positive priority
+bool parsePendingLine(StringView line, PendingEntry& entry) {
+    line = line.trim();
+    size_t space = line.find(' ');
+    if (space == std::string::npos) return false;
+    if (!parseLong(line.substr(space + 1).trim(), entry.priority) || entry.priority <= 0) return false;
+    entry.jobId = parseJobNumber(line);
+    return true;
+}
+
+// Parse complete kPendingQueueCommand output into entries with up to threads
+// threads. The text is split into runs of whole lines at the first newline after
+// each equal share; every thread parses its run into a vector of its own, and the
+// runs are appended in input order.
+void parsePendingQueue(StringView text, int threads, std::vector<PendingEntry>& entries) {
+    auto parseRun = [](StringView run, std::vector<PendingEntry>& out) {
+        FieldTokenizer lines(run);
+        StringView line;
+        PendingEntry entry;
+        while (lines.next('\n', line)) {
+            if (parsePendingLine(line, entry)) out.push_back(entry);
+        }
+    };
+    size_t parts = std::max<size_t>(1, std::min<size_t>(threads, text.size() / kMinParseBytesPerThread));
+    if (parts == 1) {
+        parseRun(text, entries);
+        return;
+    }
+
+    std::vector<StringView> runs;
+    size_t begin = 0;
+    for (size_t i = 1; i <= parts && begin < text.size(); i++) {
+        size_t end = text.size();
+        if (i < parts) {
+            size_t nl = text.find('\n', std::max(begin, text.size() / parts * i));
+            if (nl != std::string::npos) end = nl + 1;
+        }
+        runs.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+
+    std::vector<std::vector<PendingEntry>> results(runs.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < runs.size(); i++) workers.push_back(std::thread(parseRun, runs[i], std::ref(results[i])));
+    parseRun(runs[0], results[0]); // The calling thread takes the first run
+    for (auto& worker : workers) worker.join();
+
+    size_t total = entries.size();
+    for (const auto& result : results) total += result.size();
+    entries.reserve(total);
+    for (const auto& result : results) entries.insert(entries.end(), result.begin(), result.end());
+}
+
+// Set up stream to run kPendingQueueCommand into entries and call onParsed once
+// all of it is there. With one thread (or core) the lines are parsed as squeue writes them;
+// with more the output is kept in text (reused across calls) and parsed in parallel
+// at the end, which adds that time to parseSeconds.
+void setupQueueStream(CommandStream& stream, std::vector<PendingEntry>& entries, int threads, std::string& text,
+                      double& parseSeconds, const std::function<void()>& onParsed) {
+    stream.cmd = kPendingQueueCommand;
+    unsigned cores = std::thread::hardware_concurrency(); // 0 if unknown
+    if (cores > 0) threads = std::min(threads, (int)cores);
+    if (threads <= 1) {
+        stream.onLine = [&entries](StringView line) {
+            PendingEntry entry;
+            if (parsePendingLine(line, entry)) entries.push_back(entry);
+        };
+        stream.onEnd = onParsed;
+        return;
+    }
+    text.clear();
+    stream.collect = &text;
+    stream.onEnd = [&entries, threads, &text, &parseSeconds, onParsed]() {
+        {
+            ScopeTimer timer(parseSeconds);
+            parsePendingQueue(text, threads, entries);
+        }
+        if (onParsed) onParsed();
+    };
+}
+
+// Snapshot of the global pending queue as published by "slurmtop --serve": a
+// header followed by count PendingEntry records, sorted by descending priority.
+// Server and clients run on the same host, so the records are sent as they are
+// laid out in memory; entrySize guards against mismatched builds.
+const char kQueueSnapshotMagic[4] = {'S', 'T', 'Q', 'S'};
+const uint32_t kQueueSnapshotVersion = 1;
+// The default socket lives in a directory the admin creates for the daemon's user,
+// so that nobody else can bind it while no daemon runs
+const char* const kDefaultQueueSocket = "/run/slurmtop/queue.sock";
+const long kMaxQueueSnapshotAge = 180;       // Seconds; older snapshots are ignored
+const uint64_t kMaxQueueSnapshotJobs = 2000000; // Far above any real queue (MaxJobCount)
+const int kQueueSocketTimeoutMs = 2000;      // Clients give up on a daemon this slow
+
+struct QueueSnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t reserved;
+    uint64_t generation;  // Increases with every fetch the daemon publishes
+    int64_t fetchedAt;    // Unix time of the squeue run the snapshot comes from
+    uint64_t count;
+};
+
+// Read the global pending queue from a --serve daemon. Returns false if no daemon
+// listens on socketPath, the peer is not run by root, this user or daemonUid, or
+// its snapshot is unusable or stale, in which case the caller queries squeue itself.
+bool readQueueSnapshot(const std::string& socketPath, uid_t daemonUid, std::vector<PendingEntry>& entries) {
+    if (socketPath.empty()) return false;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) return false;
+    memcpy(addr.sun_path, socketPath.c_str(), socketPath.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Whoever listens decides every client's queue ranks: check who that is
+    struct ucred peer;
+    socklen_t peerSize = sizeof(peer);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &peerSize) != 0 ||
+        (peer.uid != 0 && peer.uid != getuid() && peer.uid != daemonUid)) {
+        close(fd);
+        return false;
+    }
+
+    // Read exactly size bytes, waiting at most kQueueSocketTimeoutMs for each chunk
+    auto readFully = [fd](char* buffer, size_t size) {
+        while (size > 0) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, kQueueSocketTimeoutMs);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0) return false;
+            ssize_t n = read(fd, buffer, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            buffer += n;
+            size -= n;
+        }
+        return true;
+    };
+
+    QueueSnapshotHeader header;
+    bool ok = readFully(reinterpret_cast<char*>(&header), sizeof(header)) &&
+              memcmp(header.magic, kQueueSnapshotMagic, sizeof(header.magic)) == 0 &&
+              header.version == kQueueSnapshotVersion && header.entrySize == sizeof(PendingEntry) &&
+              header.count <= kMaxQueueSnapshotJobs && time(nullptr) - header.fetchedAt <= kMaxQueueSnapshotAge;
+    if (ok) {
+        entries.resize(header.count);
+        ok = readFully(reinterpret_cast<char*>(entries.data()), header.count * sizeof(PendingEntry));
+    }
+    close(fd);
+    if (!ok) entries.clear();
+    return ok;
+}
+
+// GPU capacity from sinfo, one line per node (and partition):
+// "NodeHost|GresUsed|StateCompact|", plus the node's configured Gres first when the
+// topology is reloaded
+const char* const kNodeUsageCommand = "sinfo -h -N -O 'NodeHost:|,GresUsed:|,StateCompact:|' 2>/dev/null";
+const char* const kNodeTopologyCommand = "sinfo -h -N -O 'NodeHost:|,Gres:|,GresUsed:|,StateCompact:|' 2>/dev/null";
+
+// How long the node topology is trusted before it is read again
+const std::chrono::minutes kTopologyMaxAge(10);
+
+// Whether a node in this sinfo state can start jobs: not down, drained, failed,
+// in maintenance, reserved or not responding ("*" suffix)
+bool nodeSchedulable(StringView state) {
+    static const char* const unusable[] = {"down", "drain", "drng", "fail", "maint", "resv", "futr", "inval", "unk"};
+    if (state.empty() || state[state.size() - 1] == '*') return false;
+    for (const char* prefix : unusable) {
+        size_t n = strlen(prefix);
+        if (state.size() >= n && memcmp(state.data(), prefix, n) == 0) return false;
+    }
+    return true;
+}
+
+// The GPUs configured on every node. They only change when the cluster is
+// reconfigured, so they are read with the allocations once every kTopologyMaxAge
+// (or when a node shows up that is not known yet), and the refreshes in between
+// only ask sinfo for what is in use.
+class GpuTopology {
+private:
+    std::unordered_map<std::string, TresUsage> nodes; // Node -> configured GPUs
+    std::chrono::steady_clock::time_point loadedAt;
+    bool loaded;
+    bool outdated; // A node was listed that is not in nodes
+
+public:
+    GpuTopology() : loaded(false), outdated(false) {}
+
+    bool needsReload() const {
+        return !loaded || outdated || std::chrono::steady_clock::now() - loadedAt >= kTopologyMaxAge;
+    }
+
+    // Reading the topology: forget the old one, add every listed node, then mark done
+    void beginReload() {
+        nodes.clear();
+        loaded = false; // Until the whole listing was read
+    }
+
+    void setNode(StringView node, StringView gres) {
+        parseGres(gres, nodes[node.str()]);
+    }
+
+    void endReload() {
+        loaded = true;
+        outdated = false;
+        loadedAt = std::chrono::steady_clock::now();
+    }
+
+    // Configured GPUs of a node, or nullptr (and a reload next time) if unknown
+    const TresUsage* find(const std::string& node) {
+        auto it = nodes.find(node);
+        if (it != nodes.end()) return &it->second;
+        outdated = true;
+        return nullptr;
+    }
+};
+
+// Default backend: runs two squeue commands. If onPartial is given, it is called
+// with the partially filled data while the queries are still streaming: throttled
+// while the user's job list comes in, and as soon as that list is complete.
+// With a queue socket, the global queue is taken from a --serve daemon when one is
+// running, and only the per-user query goes to slurmctld.
+class SqueueDataSource : public SlurmDataSource {
+private:
+    std::string queueSocket;
+    uid_t queueSocketOwner;
+    GpuTopology topology;
+    std::string queueText; // Queue output for the parallel parse
+
+public:
+    explicit SqueueDataSource(const std::string& socketPath = "", uid_t socketOwner = 0)
+        : queueSocket(socketPath), queueSocketOwner(socketOwner) {}
+
+    const char* name() const override { return "squeue"; }
+
+    bool fetch(SlurmData& data, const PartialFn& onPartial) override {
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point lastPublish = Clock::now();
+        bool userJobsDone = false;
+        size_t publishedJobs = 0;
+        auto publish = [&]() {
+            lastPublish = Clock::now();
+            publishedJobs = data.jobs.size();
+            if (onPartial) onPartial(data);
+        };
+
+        // Both queries run concurrently and are parsed while their output streams in
+        std::vector<CommandStream> streams(2);
+
+        // Fetch ALL selected jobs (of every listed user and account) in ONE squeue call
+        // with comprehensive format string. Using pipe delimiter for easy parsing:
+        // JobID|Name|Account|State|Reason|TimeUsed|TimeLimit|Priority|TresAlloc|UserName|
+        streams[0].cmd = "squeue" + data.selection.squeueOptions() + " -h --Format='JobID:|,Name:|,Account:|,State:|,Reason:|,TimeUsed:|,TimeLimit:|,PriorityLong:|,tres-alloc:|,UserName:|' 2>/dev/null";
+        streams[0].onLine = [&data](StringView line) {
+            if (line.empty()) return;
+
+            // TimeUsed (field 5) changes every refresh for running jobs, so it is left
+            // out of the record hash and updated separately for unchanged jobs
+            size_t idEnd = line.find('|');
+            size_t timeStart = idEnd, timeEnd = idEnd;
+            for (int field = 2; field <= 5 && timeStart != std::string::npos; field++) {
+                timeStart = line.find('|', timeStart + 1);
+            }
+            if (timeStart != std::string::npos) timeEnd = line.find('|', timeStart + 1);
+            if (idEnd == std::string::npos || timeEnd == std::string::npos) {
+                timeStart = timeEnd = line.size();
+            }
+
+            uint64_t hash = hashBytes(line.substr(timeEnd), hashBytes(line.substr(0, timeStart)));
+            std::string jobId = stripControlChars(line.substr(0, idEnd).trim());
+            Job* unchanged = data.updateJob(jobId, hash, [&line]() { return parseJobFromSqueue(line); });
+            if (unchanged && timeStart < timeEnd) {
+                unchanged->runtimeSeconds = parseSlurmDuration(line.substr(timeStart + 1, timeEnd - timeStart - 1).trim());
+            }
+        };
+
+        streams[0].onEnd = [&]() {
+            userJobsDone = true;
+            data.totalJobs = data.jobs.size();
+            publish(); // Running/All views are usable now, even if the global queue is not
+        };
+
+        bool fromDaemon;
+        {
+            ScopeTimer timer(data.stats.queueSeconds);
+            fromDaemon = readQueueSnapshot(queueSocket, queueSocketOwner, data.allPendingJobs);
+        }
+        if (fromDaemon) {
+            data.pendingQueueLoaded = true; // The daemon sends the queue already sorted
+            data.stats.bytesRead += data.allPendingJobs.size() * sizeof(PendingEntry);
+            streams.pop_back();
+        } else {
+            data.stats.queueSeconds = 0; // Only the failed connect; the squeue run counts
+            // Fetch all pending job priorities using squeue format (NO scontrol needed!)
+            // Format: "jobid priority" - much faster than calling scontrol for each job
+            setupQueueStream(streams[1], data.allPendingJobs, parseThreads, queueText, data.stats.parseSeconds,
+                             [&data]() { data.finishPendingQueue(); });
+        }
+
+        std::map<std::string, GpuCapacity> capacity;
+        std::unordered_set<std::string> nodesSeen;
+        size_t capacityStream = streams.size();
+        bool askCapacity = takeCapacityTurn();
+        bool reloadTopology = askCapacity && topology.needsReload();
+        if (askCapacity) {
+            streams.push_back(CommandStream());
+            setupCapacityStream(streams.back(), reloadTopology, capacity, nodesSeen);
+        }
+
+        runCommands(streams, [&]() {
+            if (!userJobsDone && data.jobs.size() != publishedJobs &&
+                Clock::now() - lastPublish >= kPartialPublishInterval) {
+                publish();
+            }
+        });
+
+        if (askCapacity) finishCapacity(data, streams[capacityStream], reloadTopology, capacity);
+
+        data.stats.jobsSeconds = streams[0].seconds;
+        if (!fromDaemon) data.stats.queueSeconds = streams[1].seconds;
+        for (const auto& stream : streams) {
+            data.stats.bytesRead += stream.reader.bytesRead;
+            data.stats.parseSeconds += stream.reader.parseSeconds;
+        }
+        data.stats.recordsParsed = data.jobs.size() + data.allPendingJobs.size() + nodesSeen.size();
+
+        // Without the complete job list and queue this refresh cannot replace the last one
+        failure.clear();
+        if (!streams[0].succeeded()) {
+            failure = "squeue " + streams[0].failure();
+        } else if (!fromDaemon && !streams[1].succeeded()) {
+            failure = "queue squeue " + streams[1].failure();
+        }
+        return failure.empty();
+    }
+
+    bool fetchCapacityOnly(SlurmData& data) override {
+        if (!takeCapacityTurn()) return false;
+        std::map<std::string, GpuCapacity> capacity;
+        std::unordered_set<std::string> nodesSeen;
+        bool reloadTopology = topology.needsReload();
+        std::vector<CommandStream> streams(1);
+        setupCapacityStream(streams[0], reloadTopology, capacity, nodesSeen);
+        runCommands(streams);
+        return finishCapacity(data, streams[0], reloadTopology, capacity);
+    }
+
+private:
+    // Cluster GPUs, tallied per node as sinfo lists them. A node is listed once per
+    // partition, so repeats are skipped.
+    void setupCapacityStream(CommandStream& nodes, bool reloadTopology, std::map<std::string, GpuCapacity>& capacity,
+                             std::unordered_set<std::string>& nodesSeen) {
+        nodes.cmd = reloadTopology ? kNodeTopologyCommand : kNodeUsageCommand;
+        if (reloadTopology) topology.beginReload();
+        nodes.onLine = [this, reloadTopology, &capacity, &nodesSeen](StringView line) {
+            FieldTokenizer fields(line);
+            StringView node, gres, used, state;
+            if (!fields.next('|', node) || (reloadTopology && !fields.next('|', gres)) ||
+                !fields.next('|', used) || !fields.next('|', state)) {
+                return;
+            }
+            std::string name = node.trim().str();
+            if (!nodesSeen.insert(name).second) return;
+            if (reloadTopology) topology.setNode(name, gres.trim());
+            const TresUsage* configured = topology.find(name);
+            if (!configured) return;
+            TresUsage inUse;
+            parseGres(used.trim(), inUse);
+            addNodeCapacity(capacity, *configured, inUse, nodeSchedulable(state.trim()));
+        };
+    }
+
+    // A failed sinfo keeps the last capacity (and the topology is read again)
+    bool finishCapacity(SlurmData& data, const CommandStream& nodes, bool reloadTopology,
+                        std::map<std::string, GpuCapacity>& capacity) {
+        if (!nodes.succeeded()) return false;
+        if (reloadTopology) topology.endReload();
+        data.gpuCapacity.swap(capacity);
+        data.capacityLoaded = true;
+        data.stats.nodesSeconds = nodes.seconds;
+        return true;
+    }
+};
+
+#ifdef HAVE_LIBSLURM
+// Native backend: a single slurm_load_jobs() RPC replaces both squeue processes
+// (no fork, no config parsing, no text formatting). The last response is kept so
+// that later calls only ask the controller for changes since its update_time.
+class LibSlurmDataSource : public SlurmDataSource {
+private:
+    job_info_msg_t* jobInfo; // Last response from slurmctld, owned
+    node_info_msg_t* nodeInfo; // Last node listing, owned; reused while unchanged
+    std::unordered_map<uid_t, InternedString> userNames; // Owners seen so far
+
+    InternedString userName(uid_t uid) {
+        auto it = userNames.find(uid);
+        if (it != userNames.end()) return it->second;
+        struct passwd* pw = getpwuid(uid);
+        InternedString name = pw ? InternedString(pw->pw_name) : InternedString(std::to_string(uid));
+        userNames[uid] = name;
+        return name;
+    }
+
+public:
+    LibSlurmDataSource() : jobInfo(nullptr), nodeInfo(nullptr) {
+#if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(20, 11, 0)
+        slurm_init(nullptr);
+#endif
+    }
+
+    ~LibSlurmDataSource() {
+        if (jobInfo) slurm_free_job_info_msg(jobInfo);
+        if (nodeInfo) slurm_free_node_info_msg(nodeInfo);
+    }
+
+    const char* name() const override { return "libslurm"; }
+
+    bool fetch(SlurmData& data, const PartialFn&) override {
+        // The same selection squeue would apply: a listed user and a listed account
+        std::unordered_set<uid_t> uids;
+        for (const auto& user : data.selection.users) {
+            struct passwd* pw = getpwnam(user.c_str());
+            if (!pw) return false;
+            uids.insert(pw->pw_uid);
+        }
+        std::unordered_set<std::string> accounts(data.selection.accounts.begin(), data.selection.accounts.end());
+
+        job_info_msg_t* response = nullptr;
+        time_t since = jobInfo ? jobInfo->last_update : 0;
+        int rc;
+        {
+            ScopeTimer timer(data.stats.jobsSeconds); // One RPC answers both queries
+            rc = slurm_load_jobs(since, &response, SHOW_ALL);
+        }
+        if (rc == SLURM_SUCCESS) {
+            if (jobInfo) slurm_free_job_info_msg(jobInfo);
+            jobInfo = response;
+        } else if (!(jobInfo && slurm_get_errno() == SLURM_NO_CHANGE_IN_DATA)) {
+            return false;
+        }
+
+        time_t now = time(nullptr);
+        ScopeTimer timer(data.stats.parseSeconds);
+        data.stats.recordsParsed = jobInfo->record_count;
+        for (uint32_t i = 0; i < jobInfo->record_count; i++) {
+            const slurm_job_info_t& info = jobInfo->job_array[i];
+            uint32_t baseState = info.job_state & JOB_STATE_BASE;
+
+            char id[64];
+            if (info.het_job_id != 0 && info.het_job_id != NO_VAL) {
+                snprintf(id, sizeof(id), "%u+%u", info.het_job_id, info.het_job_offset);
+            } else if (info.array_task_str) {
+                snprintf(id, sizeof(id), "%u_[%s]", info.array_job_id, info.array_task_str);
+            } else if (info.array_task_id != NO_VAL) {
+                snprintf(id, sizeof(id), "%u_%u", info.array_job_id, info.array_task_id);
+            } else {
+                snprintf(id, sizeof(id), "%u", info.job_id);
+            }
+
+            if (baseState == JOB_PENDING && info.priority > 0) {
+                PendingEntry pending;
+                pending.jobId = info.job_id;
+                pending.priority = info.priority;
+                data.allPendingJobs.push_back(pending);
+            }
+
+            if (!uids.empty() && !uids.count(info.user_id)) continue;
+            if (!accounts.empty() && !(info.account && accounts.count(info.account))) continue;
+
+            long elapsed = 0;
+            if (baseState == JOB_RUNNING && info.start_time > 0) elapsed = now - info.start_time;
+            long runtime = std::max(0L, elapsed);
+
+            // Run time changes constantly, so it is kept out of the record hash
+            const char* tres = info.tres_alloc_str ? info.tres_alloc_str : info.tres_req_str;
+            uint64_t hash = kHashSeed;
+            uint32_t numbers[] = {info.job_state, info.state_reason, info.priority, info.time_limit};
+            hash = hashBytes(StringView(reinterpret_cast<const char*>(numbers), sizeof(numbers)), hash);
+            hash = hashBytes(info.name ? info.name : "", hash);
+            hash = hashBytes(info.account ? info.account : "", hash);
+            hash = hashBytes(tres ? tres : "", hash);
+
+            Job* unchanged = data.updateJob(id, hash, [&]() {
+                Job job = jobFromInfo(info, id, runtime, tres);
+                job.user = userName(info.user_id);
+                return job;
+            });
+            if (unchanged) unchanged->runtimeSeconds = runtime;
+        }
+
+        data.finishPendingQueue();
+        if (takeCapacityTurn()) loadCapacity(data);
+        return true;
+    }
+
+    bool fetchCapacityOnly(SlurmData& data) override {
+        return takeCapacityTurn() && loadCapacity(data);
+    }
+
+private:
+    // Cluster GPUs from slurm_load_node(). Like the jobs, the listing is only sent
+    // again when a node changed; a failed RPC keeps the last capacity. True if the
+    // capacity was tallied again.
+    bool loadCapacity(SlurmData& data) {
+        node_info_msg_t* response = nullptr;
+        time_t since = nodeInfo ? nodeInfo->last_update : 0;
+        int rc;
+        {
+            ScopeTimer timer(data.stats.nodesSeconds);
+            rc = slurm_load_node(since, &response, SHOW_ALL);
+        }
+        if (rc == SLURM_SUCCESS) {
+            if (nodeInfo) slurm_free_node_info_msg(nodeInfo);
+            nodeInfo = response;
+        } else if (!(nodeInfo && slurm_get_errno() == SLURM_NO_CHANGE_IN_DATA)) {
+            return false;
+        } else if (data.capacityLoaded) {
+            return false; // Nothing changed since the capacity was last tallied
+        }
+
+        ScopeTimer timer(data.stats.parseSeconds);
+        std::map<std::string, GpuCapacity> capacity;
+        const uint32_t unusable = NODE_STATE_DRAIN | NODE_STATE_NO_RESPOND | NODE_STATE_FAIL | NODE_STATE_MAINT;
+        for (uint32_t i = 0; i < nodeInfo->record_count; i++) {
+            const node_info_t& node = nodeInfo->node_array[i];
+            if (!node.gres) continue;
+            TresUsage configured, inUse;
+            parseGres(node.gres, configured);
+            parseGres(node.gres_used ? node.gres_used : "", inUse);
+            uint32_t base = node.node_state & NODE_STATE_BASE;
+            bool schedulable = base != NODE_STATE_DOWN && base != NODE_STATE_FUTURE && !(node.node_state & unusable);
+            addNodeCapacity(capacity, configured, inUse, schedulable);
+        }
+        data.gpuCapacity.swap(capacity);
+        data.capacityLoaded = true;
+        return true;
+    }
+
+    static Job jobFromInfo(const slurm_job_info_t& info, const char* id, long runtime, const char* tres) {
+        Job job;
+        job.jobId = id;
+        job.jobNumber = info.job_id;
+        job.groupNumber = parseGroupNumber(job.jobId);
+        job.jobName = stripControlChars(info.name ? info.name : "");
+        job.account = internPrintable(info.account ? info.account : "");
+        job.state = slurm_job_state_string(info.job_state);
+        job.reason = slurm_job_reason_string(static_cast<enum job_state_reason>(info.state_reason));
+        job.priority = info.priority;
+        job.runtimeSeconds = runtime;
+        if (info.time_limit == INFINITE) job.timeLimitSeconds = kDurationUnlimited;
+        else if (info.time_limit == NO_VAL) job.timeLimitSeconds = kDurationNotSet;
+        else job.timeLimitSeconds = (long)info.time_limit * 60;
+
+        parseTres(tres ? tres : "", job);
+        return job;
+    }
+};
+#endif
+
+// Tries the preferred backend and falls back to squeue whenever it fails
+class FallbackDataSource : public SlurmDataSource {
+private:
+    std::unique_ptr<SlurmDataSource> primary;
+    SqueueDataSource fallback;
+    bool primaryFailed; // The last fetch() came from the fallback
+
+public:
+    FallbackDataSource(std::unique_ptr<SlurmDataSource> preferred, const std::string& queueSocket,
+                       uid_t queueSocketOwner)
+        : primary(std::move(preferred)), fallback(queueSocket, queueSocketOwner), primaryFailed(false) {}
+
+    const char* name() const override { return primary->name(); }
+
+    void setFetchCapacity(bool enabled) override {
+        primary->setFetchCapacity(enabled);
+        fallback.setFetchCapacity(enabled);
+    }
+
+    void setParseThreads(int threads) override {
+        primary->setParseThreads(threads);
+        fallback.setParseThreads(threads);
+    }
+
+    bool fetch(SlurmData& data, const PartialFn& onPartial) override {
+        primaryFailed = !primary->fetch(data, onPartial);
+        if (!primaryFailed) return true;
+        data.beginUpdate();
+        data.stats = FetchStats(); // Break down the fallback's run only
+        return fallback.fetch(data, onPartial);
+    }
+
+    // From the backend that served the last fetch()
+    bool fetchCapacityOnly(SlurmData& data) override {
+        return primaryFailed ? fallback.fetchCapacityOnly(data) : primary->fetchCapacityOnly(data);
+    }
+
+    const std::string& lastFailure() const override { return fallback.lastFailure(); }
+};
+
+// Create the data source for a --backend name ("auto", "squeue" or "libslurm");
+// returns nullptr for unknown or not compiled-in backends. queueSocket is where the
+// squeue backend looks for a --serve daemon ("" for none), which is trusted if it
+// runs as root, as this user or as queueSocketOwner.
+std::unique_ptr<SlurmDataSource> createDataSource(const std::string& backend, const std::string& queueSocket = "",
+                                                  uid_t queueSocketOwner = 0) {
+#ifdef HAVE_LIBSLURM
+    if (backend == "auto" || backend == "libslurm") {
+        return std::unique_ptr<SlurmDataSource>(new FallbackDataSource(
+            std::unique_ptr<SlurmDataSource>(new LibSlurmDataSource()), queueSocket, queueSocketOwner));
+    }
+#else
+    if (backend == "auto") return std::unique_ptr<SlurmDataSource>(new SqueueDataSource(queueSocket, queueSocketOwner));
+#endif
+    if (backend == "squeue") return std::unique_ptr<SlurmDataSource>(new SqueueDataSource(queueSocket, queueSocketOwner));
+    return nullptr;
+}
+
+// Fetch all SLURM data from the given backend. data is updated incrementally:
+// jobs are kept across calls and only re-parsed when their record changed.
+// Returns false if the source failed; the jobs are then all kept (not dropped as
+// ended), but the model is only fit to show again after a successful call.
+bool fetchSlurmData(SlurmData& data, SlurmDataSource& source, const PartialFn& onPartial = nullptr) {
+    data.stats = FetchStats();
+    bool fetched;
+    {
+        ScopeTimer timer(data.stats.totalSeconds);
+        data.beginUpdate();
+        data.complete = false;
+
+        fetched = source.fetch(data, onPartial);
+
+        if (fetched) {
+            data.endUpdate();
+            if (!data.pendingQueueLoaded) data.finishPendingQueue();
+            data.updateQueueRanks();
+        }
+    }
+    data.stats.refresh = data.updateGeneration;
+    data.complete = true;
+    return fetched;
+}
+
+// Snapshot file: the last complete SlurmData of a user, saved at exit and shown at
+// the next start until live data arrives. The file is mapped as it is: a header,
+// fixed-size job records, the sorted pending queue and a string table that the
+// records point into by offset. Loading re-links those offsets (interning the
+// low-cardinality strings) and copies the queue; the counters and GPU maps are
+// rebuilt from the jobs.
+const char kSnapshotMagic[4] = {'S', 'T', 'S', 'N'};
+const uint32_t kSnapshotVersion = 3;
+
+struct SnapshotString {
+    uint32_t offset; // Into the string table
+    uint32_t length;
+};
+
+struct SnapshotJob {
+    SnapshotString jobId, jobName, account, user, state, reason, gpuType;
+    SnapshotString gpuTypeNames[kGpuSlots];
+    int32_t gpuCounts[kGpuSlots];
+    uint64_t jobNumber;
+    int64_t runtimeSeconds;
+    int64_t timeLimitSeconds;
+    int64_t priority;
+    int64_t memoryMB;
+    int32_t gpuCount;
+    int32_t higherCount;
+    int32_t cpus;
+    int32_t nodes;
+    int32_t gpuTypes;
+    int32_t reserved;
+};
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t jobRecordSize;     // sizeof(SnapshotJob) of the writer
+    uint32_t pendingRecordSize; // sizeof(PendingEntry) of the writer
+    int64_t savedAt;            // Unix time the data was fetched
+    uint64_t jobCount;
+    uint64_t pendingCount;
+    uint64_t stringBytes;
+    uint32_t pendingQueueLoaded;
+    uint32_t reserved;
+};
+
+// $XDG_CACHE_HOME/slurmtop/<key>.snapshot (~/.cache if unset), where key is the
+// JobSelection key (the user name for a single user); "" without a home.
+// With create, the directories are made if missing.
+std::string snapshotPath(const std::string& key, bool create) {
+    std::string dir;
+    const char* cache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (cache && *cache) dir = cache;
+    else if (home && *home) dir = std::string(home) + "/.cache";
+    else return "";
+    if (create) mkdir(dir.c_str(), 0700);
+    dir += "/slurmtop";
+    if (create) mkdir(dir.c_str(), 0700);
+    return dir + "/" + key + ".snapshot";
+}
+
+// Write data's jobs and queue to the snapshot file (via a temporary file and
+// rename, so that readers never see a half-written snapshot)
+bool saveSnapshot(const SlurmData& data) {
+    std::string path = snapshotPath(data.selection.key(), true);
+    if (path.empty()) return false;
+    time_t fetchedAt = time(nullptr) - std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - data.updatedAt).count();
+
+    std::string strings;
+    std::unordered_map<const std::string*, SnapshotString> internedOffsets; // Each interned string once
+    auto addString = [&strings](const std::string& text) {
+        SnapshotString ref = {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size())};
+        strings += text;
+        return ref;
+    };
+    auto addInterned = [&](const InternedString& text) {
+        auto it = internedOffsets.find(&text.str());
+        if (it != internedOffsets.end()) return it->second;
+        SnapshotString ref = addString(text.str());
+        internedOffsets[&text.str()] = ref;
+        return ref;
+    };
+
+    std::vector<SnapshotJob> records(data.jobs.size());
+    for (size_t i = 0; i < data.jobs.size(); i++) {
+        const Job& job = data.jobs[i];
+        SnapshotJob& record = records[i];
+        memset(&record, 0, sizeof(record));
+        record.jobId = addString(job.jobId);
+        record.jobName = addString(job.jobName);
+        record.account = addInterned(job.account);
+        record.user = addInterned(job.user);
+        record.state = addInterned(job.state);
+        record.reason = addInterned(job.reason);
+        record.gpuType = addInterned(job.gpuType);
+        for (int t = 0; t < job.tres.gpuTypes; t++) {
+            record.gpuTypeNames[t] = addInterned(job.tres.gpus[t].type);
+            record.gpuCounts[t] = job.tres.gpus[t].count;
+        }
+        record.jobNumber = job.jobNumber;
+        record.runtimeSeconds = job.runtimeSeconds;
+        record.timeLimitSeconds = job.timeLimitSeconds;
+        record.priority = job.priority;
+        record.memoryMB = job.tres.memoryMB;
+        record.gpuCount = job.gpuCount;
+        record.higherCount = job.higherCount;
+        record.cpus = job.tres.cpus;
+        record.nodes = job.tres.nodes;
+        record.gpuTypes = job.tres.gpuTypes;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.jobRecordSize = sizeof(SnapshotJob);
+    header.pendingRecordSize = sizeof(PendingEntry);
+    header.savedAt = fetchedAt;
+    header.jobCount = records.size();
+    header.pendingCount = data.pendingQueueLoaded ? data.allPendingJobs.size() : 0;
+    header.stringBytes = strings.size();
+    header.pendingQueueLoaded = data.pendingQueueLoaded;
+
+    std::string temp = path + ".tmp";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    auto writeAll = [fd](const void* bytes, size_t size) {
+        const char* p = static_cast<const char*>(bytes);
+        while (size > 0) {
+            ssize_t n = write(fd, p, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= n;
+        }
+        return true;
+    };
+    bool ok = writeAll(&header, sizeof(header)) &&
+              writeAll(records.data(), records.size() * sizeof(SnapshotJob)) &&
+              writeAll(data.allPendingJobs.data(), header.pendingCount * sizeof(PendingEntry)) &&
+              writeAll(strings.data(), strings.size());
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Load the user's snapshot file into data, marked stale. Returns false (leaving
+// data untouched) if there is none or it was written by an incompatible version.
+bool loadSnapshot(SlurmData& data) {
+    std::string path = snapshotPath(data.selection.key(), false);
+    if (path.empty()) return false;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    const char* base = static_cast<const char*>(mapping);
+    SnapshotHeader header;
+    memcpy(&header, base, sizeof(header));
+    size_t jobsOffset = sizeof(SnapshotHeader);
+    bool ok = memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) == 0 &&
+              header.version == kSnapshotVersion && header.jobRecordSize == sizeof(SnapshotJob) &&
+              header.pendingRecordSize == sizeof(PendingEntry) &&
+              header.jobCount <= size / sizeof(SnapshotJob) && header.pendingCount <= size / sizeof(PendingEntry) &&
+              jobsOffset + header.jobCount * sizeof(SnapshotJob) + header.pendingCount * sizeof(PendingEntry) +
+                  header.stringBytes == size;
+    if (!ok) {
+        munmap(mapping, size);
+        return false;
+    }
+
+    const SnapshotJob* records = reinterpret_cast<const SnapshotJob*>(base + jobsOffset);
+    const PendingEntry* pending = reinterpret_cast<const PendingEntry*>(records + header.jobCount);
+    const char* strings = reinterpret_cast<const char*>(pending + header.pendingCount);
+    bool valid = true;
+    auto text = [&](const SnapshotString& ref) {
+        if ((uint64_t)ref.offset + ref.length > header.stringBytes) {
+            valid = false;
+            return StringView();
+        }
+        return StringView(strings + ref.offset, ref.length);
+    };
+
+    SlurmData loaded;
+    loaded.selection = data.selection;
+    loaded.jobs.reserve(header.jobCount);
+    for (uint64_t i = 0; i < header.jobCount && valid; i++) {
+        const SnapshotJob& record = records[i];
+        Job job;
+        job.jobId = text(record.jobId).str();
+        job.jobName = text(record.jobName).str();
+        job.account = text(record.account);
+        job.user = text(record.user);
+        job.state = text(record.state);
+        job.reason = text(record.reason);
+        job.gpuType = text(record.gpuType);
+        job.tres.gpuTypes = std::max(0, std::min<int32_t>(record.gpuTypes, kGpuSlots));
+        for (int t = 0; t < job.tres.gpuTypes; t++) {
+            job.tres.gpus[t].type = text(record.gpuTypeNames[t]);
+            job.tres.gpus[t].count = record.gpuCounts[t];
+        }
+        job.jobNumber = record.jobNumber;
+        job.groupNumber = parseGroupNumber(job.jobId);
+        job.runtimeSeconds = record.runtimeSeconds;
+        job.timeLimitSeconds = record.timeLimitSeconds;
+        job.priority = record.priority;
+        job.tres.memoryMB = record.memoryMB;
+        job.gpuCount = record.gpuCount;
+        job.higherCount = record.higherCount;
+        job.tres.cpus = record.cpus;
+        job.tres.nodes = record.nodes;
+        loaded.addJob(job);
+    }
+    loaded.allPendingJobs.assign(pending, pending + header.pendingCount);
+    munmap(mapping, size);
+    if (!valid) return false;
+
+    loaded.totalJobs = loaded.jobs.size();
+    loaded.pendingQueueLoaded = header.pendingQueueLoaded != 0;
+    loaded.loaded = loaded.complete = true;
+    loaded.stale = true;
+    time_t age = std::max<time_t>(0, time(nullptr) - header.savedAt);
+    loaded.updatedAt = std::chrono::steady_clock::now() - std::chrono::seconds(age);
+    std::swap(data, loaded);
+    return true;
+}
+
+// Auto-refresh policy. The interval never drops below the one the user asked for
+// (nor below kMinRefreshInterval), backs off while squeue is slow so fetching
+// takes at most kMaxFetchDuty of the wall time, and eases back towards the
+// requested interval once the controller answers quickly again.
+const double kMinRefreshInterval = 2.0;  // Seconds; hard floor to protect slurmctld
+const double kMaxFetchDuty = 0.2;        // Max fraction of the interval spent fetching
+const double kMaxBackoffFactor = 8.0;    // Never stretch beyond 8x the requested interval
+
+double nextRefreshInterval(double current, double requested, double fetchSeconds) {
+    double base = std::max(requested, kMinRefreshInterval);
+    double needed = fetchSeconds / kMaxFetchDuty;
+
+    double next;
+    if (needed > current) {
+        next = std::max(needed, current * 2.0);   // Slow controller: back off quickly
+    } else if (needed < current / 2.0) {
+        next = std::max(needed, current * 0.75);  // Idle controller: speed up gradually
+    } else {
+        next = current;
+    }
+
+    next = std::min(next, base * kMaxBackoffFactor);
+    return std::max(next, base);
+}
+
+// Retry policy after failed refreshes: the delay doubles from the refresh interval
+// with every failure in a row, up to kMaxRetryDelay, and is drawn at random from
+// its upper half, so that the sessions of a whole cluster that lost slurmctld at
+// the same moment neither hammer it nor come back in lockstep.
+const double kMaxRetryDelay = 300.0; // Seconds
+
+class RetryBackoff {
+private:
+    int failures; // In a row
+    std::minstd_rand random;
+
+public:
+    RetryBackoff() : failures(0), random((unsigned)getpid() ^ (unsigned)time(nullptr)) {}
+
+    void succeeded() { failures = 0; }
+
+    // Count a failure; returns the seconds to wait before the next attempt
+    double failed(double interval) {
+        failures++;
+        double delay = std::max(interval, kMinRefreshInterval);
+        for (int i = 1; i < failures && delay < kMaxRetryDelay; i++) delay *= 2;
+        delay = std::min(delay, kMaxRetryDelay);
+        std::uniform_real_distribution<double> jitter(0.5, 1.0);
+        return std::max(delay * jitter(random), kMinRefreshInterval);
+    }
+};
+
+// Background fetcher: runs fetchSlurmData() on its own thread into a back buffer
+// and hands finished snapshots to the UI thread, so the UI never blocks on squeue
+class DataFetcher {
+private:
+    SlurmDataSource& source;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    SlurmData model;        // Incrementally updated job model, only touched by the fetcher thread
+    SlurmData spare;        // Back buffer the next snapshot is copied into
+    SlurmData ready;        // Latest finished snapshot not yet taken by the UI
+    bool hasUpdate;
+    bool refreshRequested;
+    bool capacityRequested; // See requestCapacity()
+    bool stopping;
+    std::atomic<bool> fetching;
+    double requestedInterval;             // Seconds between auto-refreshes, 0 = manual only
+    std::atomic<double> currentInterval;  // Adapted interval actually in use
+    bool deliveredComplete;               // A complete snapshot has been handed out
+    std::atomic<bool> capacityWanted;     // The overview is shown: fetch the cluster's GPUs too
+    RetryBackoff backoff;
+    std::string failure;                  // Why the last fetch failed, empty after a good one
+    std::chrono::steady_clock::time_point retryAt; // When a failed fetch is tried again
+    int notifyPipe[2];                    // Written whenever there is something new to show
+
+    // Wake up the UI's poll() loop. The pipe is non-blocking: if it is full, a
+    // wakeup is already pending.
+    void notifyUI() {
+        char byte = 1;
+        ssize_t written = write(notifyPipe[1], &byte, 1);
+        (void)written;
+    }
+
+    // Publish a snapshot that is still being filled. Only done until the first
+    // complete snapshot exists; later refreshes keep the previous data on screen
+    // instead of replacing it with a half-loaded one.
+    void publishPartial(const SlurmData& partial) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (deliveredComplete || stopping) return;
+        ready = partial.partialCopy();
+        hasUpdate = true;
+        notifyUI();
+    }
+
+    // Between two refreshes: update the model's capacity alone and publish it, if
+    // the source says it is due. Not after a failed fetch, which leaves the model
+    // half updated. Called and returns with the lock held.
+    void refreshCapacity(std::unique_lock<std::mutex>& lock) {
+        capacityRequested = false;
+        if (!model.loaded || !failure.empty()) return;
+        lock.unlock();
+        source.setFetchCapacity(capacityWanted);
+        bool updated = source.fetchCapacityOnly(model);
+        if (updated) model.copySnapshotTo(spare);
+        lock.lock();
+        if (!updated || stopping) return;
+        std::swap(ready, spare);
+        hasUpdate = true;
+        notifyUI();
+    }
+
+    void threadMain() {
+        typedef std::chrono::steady_clock Clock;
+        std::unique_lock<std::mutex> lock(mutex);
+        Clock::time_point nextDue = Clock::now();
+
+        while (!stopping) {
+            auto woken = [this] { return refreshRequested || capacityRequested || stopping; };
+            bool timed = requestedInterval > 0 || !failure.empty();
+            if (timed) {
+                cv.wait_until(lock, nextDue, woken);
+            } else {
+                cv.wait(lock, woken);
+            }
+            if (stopping) break;
+            if (capacityRequested && !refreshRequested && (!timed || Clock::now() < nextDue)) {
+                refreshCapacity(lock);
+                continue;
+            }
+            refreshRequested = capacityRequested = false;
+            fetching = true;
+            notifyUI(); // Show that a refresh is running, also for timed ones
+            lock.unlock();
+            source.setFetchCapacity(capacityWanted);
+
+            // Update the model and fill the back buffer without holding the lock.
+            // Copying into the recycled buffer reuses its allocations.
+            Clock::time_point fetchStart = Clock::now();
+            bool fetched = fetchSlurmData(model, source, [this](const SlurmData& partial) { publishPartial(partial); });
+            Clock::time_point fetchEnd = Clock::now();
+
+            // The next auto-refresh is scheduled from the end of this fetch, so at
+            // most one fetch per interval is ever in flight for this user. A failed
+            // fetch publishes nothing (the UI keeps the last good snapshot) and is
+            // retried with backoff, also without auto-refresh.
+            if (fetched) {
+                model.loaded = true;
+                model.updatedAt = fetchEnd;
+                model.copySnapshotTo(spare);
+                backoff.succeeded();
+                double fetchSeconds = std::chrono::duration<double>(fetchEnd - fetchStart).count();
+                if (requestedInterval > 0) {
+                    currentInterval = nextRefreshInterval(currentInterval, requestedInterval, fetchSeconds);
+                    nextDue = fetchEnd + std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(currentInterval));
+                }
+            } else {
+                nextDue = fetchEnd + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(backoff.failed(currentInterval)));
+            }
+
+            lock.lock();
+            if (fetched) {
+                std::swap(ready, spare);
+                hasUpdate = true;
+                deliveredComplete = true;
+                failure.clear();
+            } else {
+                failure = source.lastFailure();
+                if (failure.empty()) failure = std::string(source.name()) + " failed";
+                retryAt = nextDue;
+            }
+            fetching = refreshRequested;
+            notifyUI();
+        }
+    }
+
+public:
+    DataFetcher(const JobSelection& selection, SlurmDataSource& dataSource, double interval)
+        : source(dataSource), hasUpdate(false), refreshRequested(false), capacityRequested(false), stopping(false),
+          fetching(false),
+          requestedInterval(interval), currentInterval(std::max(interval, kMinRefreshInterval)),
+          deliveredComplete(false), capacityWanted(false) {
+        model.selection = selection;
+        if (pipe2(notifyPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+            notifyPipe[0] = notifyPipe[1] = -1;
+        }
+    }
+
+    ~DataFetcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        killRunningCommands();
+        if (worker.joinable()) worker.join();
+        if (notifyPipe[0] >= 0) close(notifyPipe[0]);
+        if (notifyPipe[1] >= 0) close(notifyPipe[1]);
+    }
+
+    void start() {
+        worker = std::thread(&DataFetcher::threadMain, this);
+    }
+
+    // The UI already shows complete (cached) data: do not replace it with partial
+    // snapshots, only with the first complete one. Call before start().
+    void skipPartialSnapshots() {
+        deliveredComplete = true;
+    }
+
+    // Whether refreshes also fetch the cluster's GPU capacity (only the overview shows it)
+    void setCapacityWanted(bool wanted) {
+        capacityWanted = wanted;
+    }
+
+    // The overview was opened: fetch the capacity now if it is older than
+    // kCapacityInterval, instead of waiting for the next refresh (or, without
+    // auto-refresh, for the next 'r')
+    void requestCapacity() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            capacityRequested = true;
+        }
+        cv.notify_all();
+    }
+
+    // Ask the fetcher thread for a new snapshot (no-op if one is already queued)
+    void requestRefresh() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            refreshRequested = true;
+            fetching = true;
+        }
+        cv.notify_all();
+    }
+
+    // Readable whenever a snapshot was published or a fetch started or finished
+    int notifyFd() const {
+        return notifyPipe[0];
+    }
+
+    // Consume pending wakeups; call before checking takeUpdate() and isFetching()
+    // so that no notification is lost
+    void clearNotifications() {
+        char buffer[64];
+        while (read(notifyPipe[0], buffer, sizeof(buffer)) > 0) {}
+    }
+
+    // Swap the latest finished snapshot into the UI's buffer, if there is one
+    bool takeUpdate(SlurmData& front) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!hasUpdate) return false;
+        std::swap(front, ready);
+        hasUpdate = false;
+        return true;
+    }
+
+    bool isFetching() const {
+        return fetching;
+    }
+
+    // Whether the last fetch failed, and if so why and in how many seconds it is
+    // retried (negative once the retry is due)
+    bool lastFailure(std::string& reason, double& retrySeconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failure.empty()) return false;
+        reason = failure;
+        retrySeconds = std::chrono::duration<double>(retryAt - std::chrono::steady_clock::now()).count();
+        return true;
+    }
+
+    bool autoRefreshEnabled() const {
+        return requestedInterval > 0;
+    }
+
+    // Interval currently used for auto-refresh, after adapting to fetch times
+    double refreshInterval() const {
+        return currentInterval;
+    }
+};
+
+// Expected start times of pending jobs, from the backfill scheduler's estimates
+// ("squeue --start"). Computing them is expensive for slurmctld, so they are only
+// asked for the jobs on screen, at most once per kStartQueryInterval and for up to
+// kMaxStartQueryJobs jobs per query, and kept per job for kStartTtl. Queries run on
+// the estimator's own thread (started by the first request); the UI only reads the
+// cache and never waits for squeue.
+const std::chrono::seconds kStartTtl(60);
+const std::chrono::seconds kStartQueryInterval(5);
+const size_t kMaxStartQueryJobs = 100;
+
+// Parse squeue's %S ("2026-10-15T09:30:00", local time); 0 for "N/A" and the like
+time_t parseStartTime(StringView text) {
+    struct tm fields;
+    memset(&fields, 0, sizeof(fields));
+    std::string value = text.str();
+    const char* end = strptime(value.c_str(), "%Y-%m-%dT%H:%M:%S", &fields);
+    if (!end || *end) return 0;
+    fields.tm_isdst = -1;
+    time_t start = mktime(&fields);
+    return start < 0 ? 0 : start;
+}
+
+// A time in the tables: "14:30" on the day of now, "Oct 15 09:30" on other days
+const int kStartTimeWidth = 12;
+
+std::string formatTableTime(time_t t, time_t now) {
+    struct tm fields, nowFields;
+    localtime_r(&t, &fields);
+    localtime_r(&now, &nowFields);
+    char buffer[32];
+    bool today = fields.tm_year == nowFields.tm_year && fields.tm_yday == nowFields.tm_yday;
+    strftime(buffer, sizeof(buffer), today ? "%H:%M" : "%b %d %H:%M", &fields);
+    return buffer;
+}
+
+// Start time for the Pending view: "N/A" without an estimate, "now" once it is due
+std::string formatStartTime(time_t start, time_t now) {
+    if (start <= 0) return "N/A";
+    if (start <= now) return "now";
+    return formatTableTime(start, now);
+}
+
+class StartEstimator {
+private:
+    struct Estimate {
+        time_t start; // 0 if slurmctld has none
+        std::chrono::steady_clock::time_point fetchedAt;
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::unordered_map<std::string, Estimate> cache; // jobId -> estimate
+    std::vector<std::string> wanted;                 // Jobs on screen at the last request
+    bool stopping;
+    int notifyPipe[2]; // Written whenever new estimates arrived
+
+    bool fresh(const std::string& jobId, std::chrono::steady_clock::time_point now) const {
+        auto it = cache.find(jobId);
+        return it != cache.end() && now - it->second.fetchedAt < kStartTtl;
+    }
+
+    // Wanted jobs without a fresh estimate, up to one query's worth. Called locked.
+    std::vector<std::string> dueJobs() const {
+        std::vector<std::string> due;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (const auto& jobId : wanted) {
+            if (due.size() == kMaxStartQueryJobs) break;
+            if (!fresh(jobId, now)) due.push_back(jobId);
+        }
+        return due;
+    }
+
+    void threadMain() {
+        typedef std::chrono::steady_clock Clock;
+        std::unique_lock<std::mutex> lock(mutex);
+        Clock::time_point nextQuery = Clock::now();
+        RetryBackoff backoff; // Failed queries leave the jobs due; do not ask every 5s
+
+        while (!stopping) {
+            std::vector<std::string> due = dueJobs();
+            if (due.empty()) {
+                // Wait for new jobs on screen, or for the first estimate to expire
+                Clock::time_point expiry = Clock::time_point::max();
+                for (const auto& jobId : wanted) {
+                    auto it = cache.find(jobId);
+                    if (it != cache.end()) expiry = std::min(expiry, it->second.fetchedAt + kStartTtl);
+                }
+                if (expiry == Clock::time_point::max()) cv.wait(lock);
+                else cv.wait_until(lock, expiry);
+                continue;
+            }
+            if (Clock::now() < nextQuery) {
+                cv.wait_until(lock, nextQuery, [this] { return stopping; });
+                continue;
+            }
+            lock.unlock();
+
+            // One query for all due jobs. squeue -j takes the numeric ids, which
+            // also select every task of an array and every het component.
+            std::string ids;
+            std::unordered_set<unsigned long> numbers;
+            for (const auto& jobId : due) {
+                if (!numbers.insert(parseJobNumber(jobId)).second) continue;
+                if (!ids.empty()) ids += ',';
+                ids += std::to_string(parseJobNumber(jobId));
+            }
+            bool answered;
+            std::string output = execCommand("squeue -h --start -j " + ids + " -o '%i|%S' 2>/dev/null", &answered);
+
+            std::unordered_map<std::string, time_t> starts;
+            size_t pos = 0;
+            while (pos < output.size()) {
+                size_t nl = output.find('\n', pos);
+                if (nl == std::string::npos) nl = output.size();
+                StringView line = StringView(output).substr(pos, nl - pos).trim();
+                pos = nl + 1;
+                size_t bar = line.find('|');
+                if (bar != std::string::npos) starts[line.substr(0, bar).str()] = parseStartTime(line.substr(bar + 1).trim());
+            }
+
+            lock.lock();
+            Clock::time_point now = Clock::now();
+            if (answered) {
+                backoff.succeeded();
+                nextQuery = now + kStartQueryInterval;
+            } else {
+                nextQuery = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+                    backoff.failed(std::chrono::duration<double>(kStartQueryInterval).count())));
+            }
+            for (const auto& entry : starts) cache[entry.first] = Estimate{entry.second, now};
+            for (const auto& jobId : due) {
+                // Asked for but not listed (started, or no estimate): "N/A" until the TTL
+                // ends. After a failed query they are asked for again instead.
+                if (answered && !starts.count(jobId)) cache[jobId] = Estimate{0, now};
+            }
+            char byte = 1;
+            ssize_t written = write(notifyPipe[1], &byte, 1);
+            (void)written;
+        }
+    }
+
+public:
+    StartEstimator() : stopping(false) {
+        if (pipe2(notifyPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+            notifyPipe[0] = notifyPipe[1] = -1;
+        }
+    }
+
+    ~StartEstimator() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+        if (notifyPipe[0] >= 0) close(notifyPipe[0]);
+        if (notifyPipe[1] >= 0) close(notifyPipe[1]);
+    }
+
+    // The pending jobs now on screen (none: the Pending view is not shown). Those
+    // without a fresh estimate are fetched in the background; estimates of jobs
+    // scrolled away stay cached while the jobs are pending.
+    void request(const std::vector<std::string>& jobIds) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobIds == wanted) return;
+            wanted = jobIds;
+            if (!worker.joinable() && !wanted.empty()) worker = std::thread(&StartEstimator::threadMain, this);
+        }
+        cv.notify_all();
+    }
+
+    // Forget the estimates of jobs that are no longer pending (started, ended or
+    // cancelled). Called with every refresh.
+    void retain(const std::vector<Job>& jobs) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (cache.empty()) return;
+        }
+        std::unordered_set<std::string> pending;
+        for (const auto& job : jobs) {
+            if (job.getState() == JobState::PENDING) pending.insert(job.jobId);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = cache.begin(); it != cache.end();) {
+            if (pending.count(it->first)) ++it;
+            else it = cache.erase(it);
+        }
+    }
+
+    // Cached estimate of a job (start 0: none); false if it has not been fetched.
+    // Expired estimates are still shown until their replacement arrives.
+    bool lookup(const std::string& jobId, time_t& start) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(jobId);
+        if (it == cache.end()) return false;
+        start = it->second.start;
+        return true;
+    }
+
+    // Readable when new estimates arrived
+    int notifyFd() const {
+        return notifyPipe[0];
+    }
+
+    // Consume pending wakeups; true if there were any
+    bool takeNotifications() {
+        char buffer[64];
+        bool any = false;
+        while (read(notifyPipe[0], buffer, sizeof(buffer)) > 0) any = true;
+        return any;
+    }
+};
+
+// scontrol details of single jobs for the detail pane. They are fetched on the
+// cache's own thread, the job under the cursor first and then its neighbours
+// (prefetched while the pane is open, so that moving the cursor finds them
+// ready), and the kDetailCacheSize most recently used are kept. Entries older than
+// kDetailTtl are shown until a fresh copy arrives.
+const size_t kDetailCacheSize = 256;
+const std::chrono::seconds kDetailTtl(30);
+
+class JobDetailCache {
+private:
+    struct Entry {
+        JobDetails details;
+        std::chrono::steady_clock::time_point fetchedAt;
+        std::list<std::string>::iterator recent; // Position in lru
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru;            // Most recently used first
+    std::string wanted;                    // Job shown in the pane
+    std::vector<std::string> neighbours;   // Prefetched after it
+    bool stopping;
+    int notifyPipe[2]; // Written whenever details arrived
+
+    bool fresh(const std::string& jobId) const {
+        auto it = entries.find(jobId);
+        return it != entries.end() && std::chrono::steady_clock::now() - it->second.fetchedAt < kDetailTtl;
+    }
+
+    // Next job to fetch, or "" if everything wanted is fresh. Called locked.
+    std::string nextJob() const {
+        if (!wanted.empty() && !fresh(wanted)) return wanted;
+        for (const auto& jobId : neighbours) {
+            if (!fresh(jobId)) return jobId;
+        }
+        return std::string();
+    }
+
+    void store(const std::string& jobId, const JobDetails& details) {
+        auto it = entries.find(jobId);
+        if (it != entries.end()) {
+            lru.erase(it->second.recent);
+        } else if (entries.size() >= kDetailCacheSize) {
+            entries.erase(lru.back());
+            lru.pop_back();
+        }
+        lru.push_front(jobId);
+        Entry& entry = entries[jobId];
+        entry.details = details;
+        entry.fetchedAt = std::chrono::steady_clock::now();
+        entry.recent = lru.begin();
+    }
+
+    void threadMain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            std::string jobId = nextJob();
+            if (jobId.empty()) {
+                // Wait for another request, or for the shown job's details to expire,
+                // so that an open pane follows a running job's state
+                auto shown = entries.find(wanted);
+                if (shown == entries.end()) cv.wait(lock);
+                else cv.wait_until(lock, shown->second.fetchedAt + kDetailTtl);
+                continue;
+            }
+            lock.unlock();
+
+            // scontrol takes "12345_7" and "678+1"; a pending array's "12345_[8-100]"
+            // is asked for by its array job id
+            std::string query = jobId.find('[') == std::string::npos ? jobId : std::to_string(parseJobNumber(jobId));
+            bool answered;
+            std::string output = execCommand("scontrol show job " + query + " 2>/dev/null", &answered);
+            JobDetails details = parseJobDetails(output);
+
+            lock.lock();
+            auto cached = entries.find(jobId);
+            if (details.jobId.empty() && !answered && cached != entries.end()) {
+                details = cached->second.details; // Keep the last good details; asked again after the TTL
+            } else if (details.jobId.empty()) {
+                details.state = answered ? "(not found)" : "(scontrol failed)";
+            }
+            store(jobId, details);
+            char byte = 1;
+            ssize_t written = write(notifyPipe[1], &byte, 1);
+            (void)written;
+        }
+    }
+
+public:
+    JobDetailCache() : stopping(false) {
+        if (pipe2(notifyPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+            notifyPipe[0] = notifyPipe[1] = -1;
+        }
+    }
+
+    ~JobDetailCache() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+        if (notifyPipe[0] >= 0) close(notifyPipe[0]);
+        if (notifyPipe[1] >= 0) close(notifyPipe[1]);
+    }
+
+    // Show jobId next, then prefetch others; replaces the previous request ("": none,
+    // the pane is closed)
+    void request(const std::string& jobId, const std::vector<std::string>& prefetch) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wanted = jobId;
+            neighbours = prefetch;
+            if (!worker.joinable()) worker = std::thread(&JobDetailCache::threadMain, this);
+        }
+        cv.notify_all();
+    }
+
+    // Cached details of a job (possibly expired); false if not fetched yet
+    bool lookup(const std::string& jobId, JobDetails& details) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(jobId);
+        if (it == entries.end()) return false;
+        lru.splice(lru.begin(), lru, it->second.recent);
+        details = it->second.details;
+        return true;
+    }
+
+    // Readable when details arrived
+    int notifyFd() const {
+        return notifyPipe[0];
+    }
+
+    // Consume pending wakeups; true if there were any
+    bool takeNotifications() {
+        char buffer[64];
+        bool any = false;
+        while (read(notifyPipe[0], buffer, sizeof(buffer)) > 0) any = true;
+        return any;
+    }
+};
+
+// Usage over time for the overview's sparklines. A series keeps its samples in
+// kHistoryTierCount rings of fixed size (1 s buckets for 15 minutes, 1 min buckets
+// for a day, 10 min buckets for a week), so memory stays the same however long
+// slurmtop runs. A bucket holds the average of the samples that fell into it. The
+// rings are indexed by bucket number, so samples need not arrive in order: sacct
+// seeding may finish after the first refreshes.
+struct HistoryTier {
+    long seconds;   // Width of a bucket
+    size_t buckets; // Ring size
+};
+const HistoryTier kHistoryTiers[] = {{1, 900}, {60, 1440}, {600, 1008}};
+const int kHistoryTierCount = 3;
+
+class TimeSeries {
+private:
+    struct Bucket {
+        long index; // Sample time / tier width, -1 while unused
+        double sum;
+        int count;
+    };
+    std::vector<Bucket> tiers[kHistoryTierCount];
+
+public:
+    TimeSeries() {
+        for (int t = 0; t < kHistoryTierCount; t++) tiers[t].assign(kHistoryTiers[t].buckets, Bucket{-1, 0, 0});
+    }
+
+    void add(time_t time, double value) {
+        for (int t = 0; t < kHistoryTierCount; t++) {
+            long index = time / kHistoryTiers[t].seconds;
+            Bucket& bucket = tiers[t][index % tiers[t].size()];
+            if (bucket.index > index) continue; // The slot holds a later bucket: too old for this tier
+            if (bucket.index < index) bucket = Bucket{index, 0, 0};
+            bucket.sum += value;
+            bucket.count++;
+        }
+    }
+
+    // Average of the samples in the tier's bucket that contains time; false if none
+    bool value(int tier, time_t time, double& average) const {
+        long index = time / kHistoryTiers[tier].seconds;
+        const Bucket& bucket = tiers[tier][index % tiers[tier].size()];
+        if (bucket.index != index || bucket.count == 0) return false;
+        average = bucket.sum / bucket.count;
+        return true;
+    }
+};
+
+// The totals of one refresh, as the overview shows them
+struct UsageSample {
+    time_t time;
+    int runningJobs;
+    int pendingJobs;
+    std::map<std::string, int> gpusRunning;   // GPU type -> count, as SlurmData::gpuTypeCount
+    std::map<std::string, int> gpusRequested; // As SlurmData::gpuTypeRequested
+
+    UsageSample() : time(0), runningJobs(0), pendingJobs(0) {}
+};
+
+UsageSample usageSample(const SlurmData& data, time_t time) {
+    UsageSample sample;
+    sample.time = time;
+    sample.runningJobs = data.runningJobs;
+    sample.pendingJobs = data.pendingJobs;
+    sample.gpusRunning = data.gpuTypeCount;
+    sample.gpusRequested = data.gpuTypeRequested;
+    return sample;
+}
+
+class UsageHistory {
+public:
+    typedef std::map<std::string, TimeSeries> TypeSeries; // GPU type -> series
+
+private:
+    TimeSeries runningJobs, pendingJobs;
+    TypeSeries gpusRunning, gpusRequested;
+    bool hasSamples;
+
+    // Types missing from a sample had no GPUs at the time
+    static void addCounts(TypeSeries& series, const std::map<std::string, int>& counts, time_t time) {
+        for (const auto& count : counts) series[count.first];
+        for (auto& entry : series) {
+            auto it = counts.find(entry.first);
+            entry.second.add(time, it == counts.end() ? 0 : it->second);
+        }
+    }
+
+public:
+    UsageHistory() : hasSamples(false) {}
+
+    void add(const UsageSample& sample) {
+        runningJobs.add(sample.time, sample.runningJobs);
+        pendingJobs.add(sample.time, sample.pendingJobs);
+        addCounts(gpusRunning, sample.gpusRunning, sample.time);
+        addCounts(gpusRequested, sample.gpusRequested, sample.time);
+        hasSamples = true;
+    }
+
+    bool empty() const { return !hasSamples; }
+    const TimeSeries& running() const { return runningJobs; }
+    const TimeSeries& pending() const { return pendingJobs; }
+    const TypeSeries& runningGpus() const { return gpusRunning; }
+    const TypeSeries& requestedGpus() const { return gpusRequested; }
+};
+
+// The last width buckets of a tier up to now, one character per bucket from '_'
+// (zero) to '#' (the peak of the range). The samples are levels and refreshes can
+// be minutes apart, so an empty bucket repeats the value before it; buckets before
+// the first sample stay blank. latest and peak receive the last and largest value.
+std::string sparkline(const TimeSeries& series, int tier, time_t now, int width, double& latest, double& peak) {
+    static const char kLevels[] = "_.-~=+*#";
+    const int levelCount = sizeof(kLevels) - 1;
+    const HistoryTier& spec = kHistoryTiers[tier];
+    time_t start = now - (width - 1) * spec.seconds;
+
+    // Value carried into the first column from the buckets before it
+    double value = -1, sample;
+    for (long back = 1; back <= (long)(spec.buckets - width) && value < 0; back++) {
+        if (series.value(tier, start - back * spec.seconds, sample)) value = sample;
+    }
+
+    std::vector<double> values(width);
+    peak = 0;
+    for (int c = 0; c < width; c++) {
+        if (series.value(tier, start + c * spec.seconds, sample)) value = sample;
+        values[c] = value;
+        peak = std::max(peak, value);
+    }
+    latest = std::max(0.0, value);
+
+    std::string line(width, ' ');
+    for (int c = 0; c < width; c++) {
+        if (values[c] < 0) continue;
+        int level = values[c] <= 0 ? 0 : std::max(1, (int)(values[c] / peak * (levelCount - 1) + 0.5));
+        line[c] = kLevels[level];
+    }
+    return line;
+}
+
+// Optional seeding of the history from sacct (--history HOURS): one query for all
+// jobs of the selection that were pending or running during the last hours, run
+// once on the seeder's own thread. A job counts as pending from its submission to
+// its start (with its requested TRES) and as running from its start to its end
+// (with its allocated TRES); the totals are sampled once per minute, which fills
+// the 1 min and 10 min tiers.
+class HistorySeeder {
+private:
+    struct SeedJob {
+        time_t submit, start, end; // 0: not started / not ended
+        TresUsage requested, allocated;
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::vector<UsageSample> samples;
+    bool done;
+    int notifyPipe[2]; // Written when the samples are ready
+
+    static void addGpus(std::map<std::string, int>& counts, const TresUsage& tres, int sign) {
+        for (int i = 0; i < tres.gpuTypes; i++) adjustCount(counts, tres.gpus[i].type.str(), sign * tres.gpus[i].count);
+    }
+
+    static std::vector<UsageSample> sampleJobs(const std::vector<SeedJob>& jobs, time_t from, time_t to) {
+        // Changes of the totals in time order: +1/-1 for a job entering or leaving
+        // the pending or the running state
+        struct Event {
+            time_t time;
+            const SeedJob* job;
+            bool running;
+            int sign;
+            bool operator<(const Event& other) const { return time < other.time; }
+        };
+        std::vector<Event> events;
+        events.reserve(jobs.size() * 4);
+        for (const auto& job : jobs) {
+            time_t pendingEnd = job.start ? job.start : job.end;
+            events.push_back(Event{job.submit, &job, false, 1});
+            if (pendingEnd) events.push_back(Event{pendingEnd, &job, false, -1});
+            if (job.start) {
+                events.push_back(Event{job.start, &job, true, 1});
+                if (job.end) events.push_back(Event{job.end, &job, true, -1});
+            }
+        }
+        std::stable_sort(events.begin(), events.end());
+
+        std::vector<UsageSample> result;
+        UsageSample totals;
+        size_t next = 0;
+        for (time_t t = from - from % 60; t < to; t += 60) {
+            for (; next < events.size() && events[next].time <= t; next++) {
+                const Event& event = events[next];
+                if (event.running) {
+                    totals.runningJobs += event.sign;
+                    addGpus(totals.gpusRunning, event.job->allocated, event.sign);
+                } else {
+                    totals.pendingJobs += event.sign;
+                    addGpus(totals.gpusRequested, event.job->requested, event.sign);
+                }
+            }
+            if (t < from) continue;
+            totals.time = t;
+            result.push_back(totals);
+        }
+        return result;
+    }
+
+    void threadMain(std::string command, time_t from, time_t to) {
+        std::string output = execCommand(command, nullptr, kAccountingTimeout);
+
+        // JobIDRaw|Submit|Start|End|ReqTRES|AllocTRES per job; Start and End are
+        // "Unknown" or "None" until they happen
+        std::vector<SeedJob> jobs;
+        size_t pos = 0;
+        while (pos < output.size()) {
+            size_t nl = output.find('\n', pos);
+            if (nl == std::string::npos) nl = output.size();
+            FieldTokenizer fields(StringView(output).substr(pos, nl - pos));
+            pos = nl + 1;
+            StringView jobId, submit, start, end, requested, allocated;
+            if (!fields.next('|', jobId) || !fields.next('|', submit) || !fields.next('|', start) ||
+                !fields.next('|', end) || !fields.next('|', requested) || !fields.next('|', allocated)) {
+                continue;
+            }
+            SeedJob job;
+            job.submit = parseStartTime(submit);
+            if (!job.submit) continue;
+            job.start = parseStartTime(start);
+            job.end = parseStartTime(end);
+            Job parsed;
+            parseTres(requested, parsed);
+            job.requested = parsed.tres;
+            parseTres(allocated, parsed);
+            job.allocated = parsed.tres;
+            jobs.push_back(job);
+        }
+
+        std::vector<UsageSample> result = sampleJobs(jobs, from, to);
+        std::lock_guard<std::mutex> lock(mutex);
+        samples.swap(result);
+        done = true;
+        char byte = 1;
+        ssize_t written = write(notifyPipe[1], &byte, 1);
+        (void)written;
+    }
+
+public:
+    HistorySeeder() : done(false) {
+        if (pipe2(notifyPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+            notifyPipe[0] = notifyPipe[1] = -1;
+        }
+    }
 
-// Job state enum
-enum class JobState {
-    RUNNING,
-    PENDING,
-    OTHER
-};
+    ~HistorySeeder() {
+        if (worker.joinable()) worker.join();
+        if (notifyPipe[0] >= 0) close(notifyPipe[0]);
+        if (notifyPipe[1] >= 0) close(notifyPipe[1]);
+    }
 
-// Job information structure
-struct Job {
-    std::string jobId;
-    std::string jobName;
-    std::string account;
-    std::string state;
-    std::string reason;
-    int gpuCount;
-    std::string gpuType;
-    std::string runtime;
-    std::string timeLimit;
-    long priority;
+    // Query the hours before now. sacct selects users and accounts with the same
+    // options as squeue, but lists only the caller's own jobs without -u.
+    void start(const JobSelection& selection, int hours) {
+        time_t now = time(nullptr);
+        std::string command = "sacct -X -n -P" + selection.squeueOptions() + (selection.users.empty() ? " -a" : "") +
+                              " -S now-" + std::to_string(hours) + "hours -E now" +
+                              " -o JobIDRaw,Submit,Start,End,ReqTRES,AllocTRES 2>/dev/null";
+        worker = std::thread(&HistorySeeder::threadMain, this, command, now - hours * 3600L, now);
+    }
 
-    JobState getState() const {
-        if (state == "RUNNING") return JobState::RUNNING;
-        if (state == "PENDING") return JobState::PENDING;
-        return JobState::OTHER;
+    // Readable when the samples are ready
+    int notifyFd() const {
+        return notifyPipe[0];
+    }
+
+    // Move the samples out once they are ready; false before that and after
+    bool take(std::vector<UsageSample>& out) {
+        char buffer[64];
+        while (read(notifyPipe[0], buffer, sizeof(buffer)) > 0) {}
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!done || samples.empty()) return false;
+        out.swap(samples);
+        samples.clear();
+        return true;
     }
 };
 
-// Global data structure
-struct SlurmData {
-    std::string username;
-    std::vector<Job> jobs;
-    std::vector<Job> allPendingJobs; // All pending jobs in queue for priority comparison
-    int totalJobs;
-    int runningJobs;
-    int pendingJobs;
-    std::map<std::string, int> gpuTypeCount; // GPU type -> count for running jobs
-    std::map<std::string, int> gpuTypeRequested; // GPU type -> count for pending jobs
+// Parse one line of the finished-jobs query (see FinishedJobs):
+// JobID|Account|User|State|ExitCode|Elapsed|End|AllocTRES|JobName. The exit code is
+// kept in reason; jobs that have not ended are skipped.
+bool parseSacctJob(StringView line, Job& job) {
+    FieldTokenizer fields(line);
+    StringView jobId, account, user, state, exitCode, elapsed, end, tres, name;
+    if (!fields.next('|', jobId) || !fields.next('|', account) || !fields.next('|', user) ||
+        !fields.next('|', state) || !fields.next('|', exitCode) || !fields.next('|', elapsed) ||
+        !fields.next('|', end) || !fields.next('|', tres) || !fields.next('|', name)) {
+        return false;
+    }
+    job.endTime = parseStartTime(end.trim());
+    if (jobId.empty() || job.endTime == 0) return false;
+    job.jobId = stripControlChars(jobId.trim());
+    job.jobNumber = parseJobNumber(job.jobId);
+    job.groupNumber = parseGroupNumber(job.jobId);
+    job.account = internPrintable(account.trim());
+    job.user = internPrintable(user.trim());
+    size_t space = state.find(' '); // "CANCELLED by 1234"
+    job.state = internPrintable(space == std::string::npos ? state : state.substr(0, space));
+    job.reason = internPrintable(exitCode.trim());
+    job.runtimeSeconds = parseSlurmDuration(elapsed.trim());
+    parseTres(tres, job);
+    job.jobName = stripControlChars(name);
+    return true;
+}
 
-    void clear() {
-        jobs.clear();
-        allPendingJobs.clear();
-        gpuTypeCount.clear();
-        gpuTypeRequested.clear();
-        totalJobs = runningJobs = pendingJobs = 0;
+// Jobs that left squeue, for the Finished view: everything of the selection that
+// ended within kFinishedWindow, from slurmdbd via sacct. The first query covers
+// the whole window; later ones start at the high-water mark (the time of the last
+// query sacct answered successfully, with or without records) minus
+// kFinishedOverlap, for records that slurmdbd stores late, so a refresh asks for
+// minutes of accounting data instead of the whole day. Results are merged by job
+// id into a cache of at most kFinishedCacheSize jobs (the most recently ended).
+// Queries run on the cache's own thread, started by the first refresh(), so only
+// sessions that open the view query slurmdbd at all, and at most once per
+// kFinishedQueryInterval however short the refresh interval is.
+const long kFinishedWindow = 24 * 3600;
+const long kFinishedOverlap = 120;
+const std::chrono::seconds kFinishedQueryInterval(15);
+const size_t kFinishedCacheSize = 5000;
+
+class FinishedJobs {
+private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string selectOptions;            // sacct options that select the jobs
+    std::unordered_map<std::string, Job> jobs; // Job id -> latest record
+    time_t highWater;                     // Jobs that ended before this are known, 0: none
+    bool queryRequested;
+    bool loaded;                          // The first query finished
+    bool changed;                         // jobs changed since the last takeUpdate()
+    bool stopping;
+    int notifyPipe[2];                    // Written after every query
+
+    static std::string sacctTime(time_t t) {
+        char buffer[32];
+        struct tm fields;
+        localtime_r(&t, &fields);
+        strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &fields);
+        return buffer;
     }
-};
 
-// Execute command and return output
-std::string execCommand(const std::string& cmd) {
-    std::string result;
-    std::shared_ptr<FILE> pipe(popen(cmd.c_str(), "r"), pclose);
-    if (!pipe) return "";
+    // Keep the window and the size bound: drop what ended before the window, then
+    // the earliest ended jobs. Called locked.
+    void evict(time_t now) {
+        for (auto it = jobs.begin(); it != jobs.end();) {
+            if (it->second.endTime < now - kFinishedWindow) it = jobs.erase(it);
+            else ++it;
+        }
+        if (jobs.size() <= kFinishedCacheSize) return;
+        std::vector<std::pair<time_t, const std::string*>> ends;
+        ends.reserve(jobs.size());
+        for (const auto& entry : jobs) ends.push_back(std::make_pair(entry.second.endTime, &entry.first));
+        size_t excess = jobs.size() - kFinishedCacheSize;
+        std::nth_element(ends.begin(), ends.begin() + excess, ends.end());
+        std::vector<std::string> evicted;
+        for (size_t i = 0; i < excess; i++) evicted.push_back(*ends[i].second);
+        for (const auto& jobId : evicted) jobs.erase(jobId);
+    }
 
-    char buffer[256];
-    while (fgets(buffer, sizeof(buffer), pipe.get()) != nullptr) {
-        result += buffer;
+    void threadMain() {
+        typedef std::chrono::steady_clock Clock;
+        std::unique_lock<std::mutex> lock(mutex);
+        Clock::time_point nextQuery = Clock::now();
+        while (!stopping) {
+            cv.wait(lock, [this] { return queryRequested || stopping; });
+            if (stopping) break;
+            if (Clock::now() < nextQuery) {
+                cv.wait_until(lock, nextQuery, [this] { return stopping; });
+                continue;
+            }
+            queryRequested = false;
+            nextQuery = Clock::now() + kFinishedQueryInterval;
+            time_t now = time(nullptr);
+            time_t from = highWater ? std::max(highWater - kFinishedOverlap, now - kFinishedWindow) : now - kFinishedWindow;
+            std::string command = "sacct -X -n --parsable2" + selectOptions + " -S " + sacctTime(from) +
+                                  " -E now -s CD,F,TO,CA,OOM,NF,PR,BF,DL"
+                                  " -o JobID,Account,User,State,ExitCode,Elapsed,End,AllocTRES,JobName 2>/dev/null";
+            lock.unlock();
+
+            bool answered;
+            std::string output = execCommand(command, &answered, kAccountingTimeout);
+            std::vector<Job> parsed;
+            size_t pos = 0;
+            while (pos < output.size()) {
+                size_t nl = output.find('\n', pos);
+                if (nl == std::string::npos) nl = output.size();
+                Job job;
+                if (parseSacctJob(StringView(output).substr(pos, nl - pos), job)) parsed.push_back(job);
+                pos = nl + 1;
+            }
+
+            lock.lock();
+            for (auto& job : parsed) jobs[job.jobId] = std::move(job);
+            // Any successful answer advances the mark, an empty one too; after a failed
+            // or timed-out sacct the same window is asked for again
+            if (answered) highWater = now;
+            evict(now);
+            loaded = true;
+            changed = true;
+            char byte = 1;
+            ssize_t written = write(notifyPipe[1], &byte, 1);
+            (void)written;
+        }
     }
-    return result;
-}
 
-// Strip control characters (newlines, tabs, etc) from string
-std::string stripControlChars(const std::string& str) {
-    std::string result;
-    for (char c : str) {
-        if (c >= 32 && c <= 126) {  // Only printable ASCII
-            result += c;
-        } else if (c == '\t') {
-            result += ' ';  // Replace tabs with spaces
+public:
+    FinishedJobs() : highWater(0), queryRequested(false), loaded(false), changed(false), stopping(false) {
+        if (pipe2(notifyPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+            notifyPipe[0] = notifyPipe[1] = -1;
         }
-        // Skip all other control characters including \n, \r
     }
-    return result;
-}
 
-// Extract value from scontrol output
-std::string extractField(const std::string& output, const std::string& fieldName) {
-    size_t pos = output.find(fieldName + "=");
-    if (pos == std::string::npos) return "";
+    ~FinishedJobs() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+        if (notifyPipe[0] >= 0) close(notifyPipe[0]);
+        if (notifyPipe[1] >= 0) close(notifyPipe[1]);
+    }
+
+    // Ask for the jobs that ended since the last query (no-op while one is queued).
+    // sacct selects users and accounts like squeue, but without -u it only lists
+    // the caller's own jobs.
+    void refresh(const JobSelection& selection) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (selectOptions.empty()) selectOptions = selection.squeueOptions() + (selection.users.empty() ? " -a" : "");
+            queryRequested = true;
+            if (!worker.joinable()) worker = std::thread(&FinishedJobs::threadMain, this);
+        }
+        cv.notify_all();
+    }
 
-    pos += fieldName.length() + 1;
-    size_t end = output.find(' ', pos);
-    if (end == std::string::npos) end = output.find('\n', pos);
-    if (end == std::string::npos) end = output.length();
+    bool started() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return worker.joinable();
+    }
 
-    std::string value = output.substr(pos, end - pos);
-    return stripControlChars(value);  // Clean the extracted value
-}
+    bool isLoaded() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return loaded;
+    }
 
-// Extract GPU info from AllocTRES or ReqTRES
-void extractGPUInfo(const std::string& output, const std::string& fieldName, int& gpuCount, std::string& gpuType) {
-    gpuCount = 0;
-    gpuType = "N/A";
+    // Copy the cached jobs into out, most recently ended first, if they changed
+    bool takeUpdate(std::vector<Job>& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!changed) return false;
+        out.clear();
+        out.reserve(jobs.size());
+        for (const auto& entry : jobs) out.push_back(entry.second);
+        std::sort(out.begin(), out.end(), [](const Job& a, const Job& b) {
+            return a.endTime != b.endTime ? a.endTime > b.endTime : a.jobNumber > b.jobNumber;
+        });
+        changed = false;
+        return true;
+    }
 
-    // Find the field (AllocTRES= or ReqTRES=) if fieldName is provided
-    // If fieldName is empty, we're parsing a TRES string directly
-    size_t searchStart = 0;
-    if (!fieldName.empty()) {
-        size_t fieldPos = output.find(fieldName + "=");
-        if (fieldPos == std::string::npos) return;
-        searchStart = fieldPos;
+    // Readable after every query
+    int notifyFd() const {
+        return notifyPipe[0];
     }
 
-    // FIRST: Try to find typed GPU pattern (gres/gpu:TYPE=COUNT)
-    // This is more specific and should be checked first
-    size_t typedGresPos = output.find("gres/gpu:", searchStart);
+    // Consume pending wakeups; true if there were any
+    bool takeNotifications() {
+        char buffer[64];
+        bool any = false;
+        while (read(notifyPipe[0], buffer, sizeof(buffer)) > 0) any = true;
+        return any;
+    }
+};
 
-    if (typedGresPos != std::string::npos) {
-        // Pattern: gres/gpu:TYPE=COUNT
-        size_t typeStart = typedGresPos + 9; // Length of "gres/gpu:"
-        size_t typeEnd = output.find('=', typeStart);
+// Cache daemon for "slurmtop --serve": fetches the global pending queue once per
+// interval and sends the latest snapshot to every client that connects, so that N
+// instances on a login node cost slurmctld one queue query per interval instead of N.
+// Fetching runs on its own thread; the main thread only accepts and writes, with
+// non-blocking sockets so that one slow client cannot hold up the others.
+const double kDefaultServeInterval = 10.0;
+const int kMaxQueueClients = 256;
+const std::chrono::seconds kQueueClientTimeout(10);
 
-        if (typeEnd != std::string::npos) {
-            // Extract type
-            gpuType = output.substr(typeStart, typeEnd - typeStart);
-            gpuType = stripControlChars(gpuType);
+class QueueServer {
+private:
+    struct Client {
+        int fd;
+        std::shared_ptr<const std::string> snapshot; // Kept alive until fully sent
+        size_t sent;
+        std::chrono::steady_clock::time_point deadline;
+    };
 
-            // Extract count
-            size_t countStart = typeEnd + 1;
-            size_t countEnd = output.find_first_of(" ,\n", countStart);
-            if (countEnd == std::string::npos) countEnd = output.length();
+    std::string socketPath;
+    double requestedInterval;
+    int parseThreads;
+    int listenFd;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping;
+    std::shared_ptr<const std::string> snapshot; // Latest serialized snapshot, null before the first fetch
+    std::vector<Client> clients;
+
+    static std::shared_ptr<const std::string> serialize(const std::vector<PendingEntry>& entries,
+                                                        uint64_t generation, time_t fetchedAt) {
+        QueueSnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kQueueSnapshotMagic, sizeof(header.magic));
+        header.version = kQueueSnapshotVersion;
+        header.entrySize = sizeof(PendingEntry);
+        header.generation = generation;
+        header.fetchedAt = fetchedAt;
+        header.count = entries.size();
+
+        std::shared_ptr<std::string> out = std::make_shared<std::string>();
+        out->reserve(sizeof(header) + entries.size() * sizeof(PendingEntry));
+        out->append(reinterpret_cast<const char*>(&header), sizeof(header));
+        out->append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PendingEntry));
+        return out;
+    }
 
-            std::string countStr = output.substr(countStart, countEnd - countStart);
-            try {
-                gpuCount = std::stoi(countStr);
-            } catch (...) {
-                gpuCount = 0;
+    void fetchLoop() {
+        typedef std::chrono::steady_clock Clock;
+        SlurmData queue; // Only its pending queue is used
+        std::string queueText;
+        uint64_t generation = 0;
+        double currentInterval = std::max(requestedInterval, kMinRefreshInterval);
+        RetryBackoff backoff;
+        Clock::time_point nextDue = Clock::now();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            cv.wait_until(lock, nextDue, [this] { return stopping; });
+            if (stopping) break;
+            lock.unlock();
+
+            Clock::time_point fetchStart = Clock::now();
+            time_t fetchedAt = time(nullptr);
+            std::vector<CommandStream> streams(1);
+            queue.allPendingJobs.clear();
+            setupQueueStream(streams[0], queue.allPendingJobs, parseThreads, queueText, queue.stats.parseSeconds, nullptr);
+            runCommands(streams);
+
+            std::shared_ptr<const std::string> fresh;
+            double delay;
+            if (streams[0].succeeded()) {
+                queue.finishPendingQueue();
+                fresh = serialize(queue.allPendingJobs, ++generation, fetchedAt);
+                backoff.succeeded();
+                double fetchSeconds = std::chrono::duration<double>(Clock::now() - fetchStart).count();
+                currentInterval = nextRefreshInterval(currentInterval, requestedInterval, fetchSeconds);
+                delay = currentInterval;
+            } else {
+                delay = backoff.failed(currentInterval);
+                std::cerr << "squeue " << streams[0].failure() << "; keeping the previous snapshot, retrying in "
+                          << (int)(delay + 0.5) << "s" << std::endl;
             }
-            return; // Found typed GPU, we're done
+            nextDue = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(delay));
+
+            lock.lock();
+            if (fresh) snapshot = fresh;
         }
     }
 
-    // SECOND: If no typed pattern found, try untyped pattern (gres/gpu=COUNT)
-    size_t untypedGresPos = output.find("gres/gpu=", searchStart);
-    if (untypedGresPos != std::string::npos) {
-        // Pattern: gres/gpu=COUNT (no type specified)
-        size_t countStart = untypedGresPos + 9; // Length of "gres/gpu="
-        size_t countEnd = output.find_first_of(" ,\n", countStart);
-        if (countEnd == std::string::npos) countEnd = output.length();
+    void acceptClients() {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return; // EAGAIN: no more pending connections
+
+            Client client;
+            client.fd = fd;
+            client.sent = 0;
+            client.deadline = std::chrono::steady_clock::now() + kQueueClientTimeout;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                client.snapshot = snapshot;
+            }
+            // Without a snapshot yet (or when overloaded) the client sees EOF and
+            // falls back to its own squeue query
+            if (!client.snapshot || (int)clients.size() >= kMaxQueueClients) {
+                close(fd);
+                continue;
+            }
+            clients.push_back(client);
+        }
+    }
 
-        std::string countStr = output.substr(countStart, countEnd - countStart);
-        try {
-            gpuCount = std::stoi(countStr);
-        } catch (...) {
-            gpuCount = 0;
+    // Send what fits into the client's socket; false once it is done or failed
+    static bool sendSome(Client& client) {
+        while (client.sent < client.snapshot->size()) {
+            ssize_t n = send(client.fd, client.snapshot->data() + client.sent,
+                             client.snapshot->size() - client.sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            if (n <= 0) return false;
+            client.sent += n;
         }
-        gpuType = "generic";
+        return false;
     }
-}
 
-// Parse job from squeue pipe-delimited line
-// Format: JobID|JobName|Account|State|Reason|TimeUsed|TimeLimit|Priority|TresAlloc|
-Job parseJobFromSqueue(const std::string& line) {
-    Job job;
-    std::istringstream ss(line);
-    std::string token;
-    int fieldIndex = 0;
+public:
+    QueueServer(const std::string& path, double interval, int threads)
+        : socketPath(path), requestedInterval(interval), parseThreads(threads), listenFd(-1), stopping(false) {}
 
-    while (std::getline(ss, token, '|')) {
-        // Strip any leading/trailing whitespace
-        size_t start = token.find_first_not_of(" \t\r\n");
-        size_t end = token.find_last_not_of(" \t\r\n");
-        if (start != std::string::npos && end != std::string::npos) {
-            token = token.substr(start, end - start + 1);
-        } else {
-            token = "";
+    ~QueueServer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
         }
-
-        switch (fieldIndex) {
-            case 0: job.jobId = stripControlChars(token); break;
-            case 1: job.jobName = stripControlChars(token); break;
-            case 2: job.account = stripControlChars(token); break;
-            case 3: job.state = stripControlChars(token); break;
-            case 4: job.reason = stripControlChars(token); break;
-            case 5: job.runtime = stripControlChars(token); break;
-            case 6: job.timeLimit = stripControlChars(token); break;
-            case 7:
-                try {
-                    job.priority = std::stol(token);
-                } catch (...) {
-                    job.priority = 0;
-                }
-                break;
-            case 8:
-                // Parse TRES allocation (format: cpu=4,mem=16G,gres/gpu:a100=2)
-                extractGPUInfo(token, "", job.gpuCount, job.gpuType);
-                break;
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+        for (auto& client : clients) close(client.fd);
+        if (listenFd >= 0) {
+            close(listenFd);
+            unlink(socketPath.c_str());
         }
-        fieldIndex++;
     }
 
-    return job;
-}
+    // Bind the socket (world-connectable) and start fetching; false with a message
+    // in error if the socket cannot be used
+    bool start(std::string& error) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path)) {
+            error = "invalid socket path";
+            return false;
+        }
+        memcpy(addr.sun_path, socketPath.c_str(), socketPath.size());
 
-// Parse job details from scontrol output (kept for backwards compatibility if needed)
-Job parseJobDetails(const std::string& jobId, const std::string& scontrolOutput) {
-    Job job;
-    job.jobId = jobId;
-    job.jobName = extractField(scontrolOutput, "JobName");
-    job.account = extractField(scontrolOutput, "Account");
-    job.state = extractField(scontrolOutput, "JobState");
-    job.reason = extractField(scontrolOutput, "Reason");
-    job.runtime = extractField(scontrolOutput, "RunTime");
-    job.timeLimit = extractField(scontrolOutput, "TimeLimit");
-
-    std::string priorityStr = extractField(scontrolOutput, "Priority");
-    try {
-        job.priority = std::stol(priorityStr);
-    } catch (...) {
-        job.priority = 0;
-    }
-
-    // Extract GPU info based on job state
-    if (job.state == "RUNNING") {
-        extractGPUInfo(scontrolOutput, "AllocTRES", job.gpuCount, job.gpuType);
-    } else {
-        // For pending jobs, try ReqTRES first, then AllocTRES
-        extractGPUInfo(scontrolOutput, "ReqTRES", job.gpuCount, job.gpuType);
-        if (job.gpuCount == 0) {
-            extractGPUInfo(scontrolOutput, "AllocTRES", job.gpuCount, job.gpuType);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            error = strerror(errno);
+            return false;
         }
-    }
 
-    return job;
-}
+        // Replace a socket left behind by a daemon that died, but not a live one
+        struct stat st;
+        if (lstat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool alive = probe >= 0 && connect(probe, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0;
+            if (probe >= 0) close(probe);
+            if (alive) {
+                close(fd);
+                error = "another slurmtop --serve is already running";
+                return false;
+            }
+            unlink(socketPath.c_str());
+        }
 
-// Parse multiple jobs from single scontrol output (separated by blank lines)
-std::vector<Job> parseMultipleJobsFromScontrol(const std::string& output) {
-    std::vector<Job> jobs;
-    std::istringstream stream(output);
-    std::string line;
-    std::string currentJobBlock;
-    std::string currentJobId;
+        if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+            error = strerror(errno);
+            close(fd);
+            return false;
+        }
+        chmod(socketPath.c_str(), 0666);
+        listenFd = fd;
+        worker = std::thread(&QueueServer::fetchLoop, this);
+        return true;
+    }
 
-    while (std::getline(stream, line)) {
-        // Check if this is the start of a new job entry
-        if (line.find("JobId=") == 0) {
-            // Save previous job if exists
-            if (!currentJobBlock.empty() && !currentJobId.empty()) {
-                jobs.push_back(parseJobDetails(currentJobId, currentJobBlock));
+    // Serve clients until stopRequested is set (checked at least once a second)
+    void run(const volatile sig_atomic_t& stopRequested) {
+        std::vector<struct pollfd> pfds;
+        while (!stopRequested) {
+            pfds.clear();
+            struct pollfd listener = {listenFd, POLLIN, 0};
+            pfds.push_back(listener);
+            for (const auto& client : clients) {
+                struct pollfd pfd = {client.fd, POLLOUT, 0};
+                pfds.push_back(pfd);
+            }
+            if (poll(pfds.data(), pfds.size(), 1000) < 0 && errno != EINTR) break;
+
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            for (size_t i = clients.size(); i-- > 0;) {
+                const struct pollfd& pfd = pfds[i + 1];
+                bool keep = now < clients[i].deadline && !(pfd.revents & (POLLERR | POLLHUP | POLLNVAL));
+                if (keep && (pfd.revents & POLLOUT)) keep = sendSome(clients[i]);
+                if (!keep) {
+                    close(clients[i].fd);
+                    clients.erase(clients.begin() + i);
+                }
             }
-            // Start new job
-            currentJobId = extractField(line, "JobId");
-            currentJobBlock = line + "\n";
-        } else if (!line.empty()) {
-            currentJobBlock += line + "\n";
+            if (pfds[0].revents & POLLIN) acceptClients();
         }
     }
+};
+
+// Format a duration in seconds as a short age string (e.g. "5s", "3m", "2h")
+std::string formatAge(long seconds) {
+    if (seconds < 60) return std::to_string(seconds) + "s";
+    if (seconds < 3600) return std::to_string(seconds / 60) + "m";
+    return std::to_string(seconds / 3600) + "h";
+}
 
-    // Don't forget the last job
-    if (!currentJobBlock.empty() && !currentJobId.empty()) {
-        jobs.push_back(parseJobDetails(currentJobId, currentJobBlock));
+// Format a memory amount in megabytes with a binary unit (e.g. "512M", "1.5T")
+std::string formatMemory(long memoryMB) {
+    const char* units = "MGTP";
+    double amount = memoryMB;
+    int unit = 0;
+    while (amount >= 1024 && unit < 3) {
+        amount /= 1024;
+        unit++;
     }
+    char buffer[32];
+    if (unit == 0 || amount >= 100) snprintf(buffer, sizeof(buffer), "%.0f%c", amount, units[unit]);
+    else snprintf(buffer, sizeof(buffer), "%.1f%c", amount, units[unit]);
+    return buffer;
+}
 
-    return jobs;
+// Summary of a group's resources for the overview (e.g. "(208 CPUs, 1.6T memory)")
+std::string formatTresTotals(const TresTotals& totals) {
+    if (totals.cpus == 0 && totals.memoryMB == 0) return "";
+    return "(" + std::to_string(totals.cpus) + " CPUs, " + formatMemory(totals.memoryMB) + " memory)";
 }
 
-// Fetch all SLURM data
-void fetchSlurmData(SlurmData& data) {
-    data.clear();
+// Resident set size of this process in megabytes, -1 if unknown
+long residentMemoryMB() {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return -1;
+    long sizePages = 0, residentPages = -1;
+    if (fscanf(statm, "%ld %ld", &sizePages, &residentPages) != 2) residentPages = -1;
+    fclose(statm);
+    return residentPages < 0 ? -1 : residentPages * (sysconf(_SC_PAGESIZE) / 1024) / 1024;
+}
+
+// The last kWindow samples of a measurement, for min/avg/p99 over recent refreshes
+class RollingStats {
+public:
+    static const int kWindow = 128;
 
-    // Fetch ALL user's jobs in ONE squeue call with comprehensive format string
-    // Using pipe delimiter for easy parsing: JobID|Name|Account|State|Reason|TimeUsed|TimeLimit|Priority|TresAlloc|
-    std::string squeueCmd = "squeue -u " + data.username + " -h --Format='JobID:|,Name:|,Account:|,State:|,Reason:|,TimeUsed:|,TimeLimit:|,PriorityLong:|,tres-alloc:|' 2>/dev/null";
-    std::string squeueOutput = execCommand(squeueCmd);
+private:
+    double samples[kWindow];
+    int count; // Valid samples, up to kWindow
+    int next;  // Slot the next sample goes into
 
-    // Parse each line as a job
-    std::istringstream iss(squeueOutput);
-    std::string line;
-    while (std::getline(iss, line)) {
-        if (line.empty()) continue;
+public:
+    RollingStats() : count(0), next(0) {}
 
-        Job job = parseJobFromSqueue(line);
-        data.jobs.push_back(job);
+    void add(double value) {
+        samples[next] = value;
+        next = (next + 1) % kWindow;
+        count = std::min(count + 1, kWindow);
+    }
 
-        if (job.state == "RUNNING") {
-            data.runningJobs++;
-            if (job.gpuCount > 0) {
-                data.gpuTypeCount[job.gpuType] += job.gpuCount;
-            }
-        } else if (job.state == "PENDING") {
-            data.pendingJobs++;
-            if (job.gpuCount > 0) {
-                data.gpuTypeRequested[job.gpuType] += job.gpuCount;
-            }
+    bool empty() const { return count == 0; }
+    double last() const { return count ? samples[(next + kWindow - 1) % kWindow] : 0; }
+    double min() const { return count ? *std::min_element(samples, samples + count) : 0; }
+
+    double avg() const {
+        double sum = 0;
+        for (int i = 0; i < count; i++) sum += samples[i];
+        return count ? sum / count : 0;
+    }
+
+    double p99() const {
+        if (!count) return 0;
+        double sorted[kWindow];
+        std::copy(samples, samples + count, sorted);
+        int rank = std::max(0, (count * 99 + 99) / 100 - 1); // Nearest-rank percentile
+        std::nth_element(sorted, sorted + rank, sorted + count);
+        return sorted[rank];
+    }
+
+    // "min/avg/p99" in one unit that suits the p99 (e.g. "172/180/231ms")
+    std::string summary() const {
+        double high = p99(), scale = 1e6;
+        const char* unit = "us";
+        if (high >= 10) {
+            scale = 1;
+            unit = "s";
+        } else if (high >= 0.001) {
+            scale = 1e3;
+            unit = "ms";
         }
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.0f/%.0f/%.0f%s", min() * scale, avg() * scale, high * scale, unit);
+        return buffer;
     }
+};
+
+// Timings of recent refreshes (from FetchStats) and redraws, shown on the stats
+// line and written to the --stats log
+class PerformanceStats {
+private:
+    RollingStats total, jobs, queue, parse, sort, draw;
+    FetchStats last;
 
-    data.totalJobs = data.jobs.size();
+public:
+    // Record the refresh that produced a snapshot; false if it was already recorded
+    // or not measured (partial or cached snapshots)
+    bool addRefresh(const FetchStats& stats) {
+        if (stats.refresh == 0 || stats.refresh == last.refresh) return false;
+        last = stats;
+        total.add(stats.totalSeconds);
+        jobs.add(stats.jobsSeconds);
+        queue.add(stats.queueSeconds);
+        parse.add(stats.parseSeconds);
+        sort.add(stats.sortSeconds);
+        return true;
+    }
 
-    // Fetch all pending job priorities using squeue format (NO scontrol needed!)
-    // Format: "jobid priority" - much faster than calling scontrol for each job
-    std::string allPendingCmd = "squeue -h -t PD -o \"%i %Q\" 2>/dev/null";
-    std::string allPendingOutput = execCommand(allPendingCmd);
+    void addDraw(double seconds) {
+        draw.add(seconds);
+    }
 
-    std::istringstream pendingIss(allPendingOutput);
-    std::string pendingLine;
-    while (std::getline(pendingIss, pendingLine)) {
-        std::istringstream lineStream(pendingLine);
-        std::string jid;
-        long priority;
+    double recordsPerSecond() const {
+        return last.parseSeconds > 0 ? last.recordsParsed / last.parseSeconds : 0;
+    }
 
-        if (lineStream >> jid >> priority && priority > 0) {
-            Job job;
-            job.jobId = jid;
-            job.priority = priority;
-            data.allPendingJobs.push_back(job);
+    // One line for the stats overlay
+    std::string summary() const {
+        char buffer[128];
+        long rss = residentMemoryMB();
+        snprintf(buffer, sizeof(buffer), "RSS %s  read %.1fMB  %.1fM rec/s  min/avg/p99:",
+                 rss < 0 ? "?" : formatMemory(rss).c_str(), last.bytesRead / 1048576.0, recordsPerSecond() / 1e6);
+        std::string line = buffer;
+        if (!total.empty()) {
+            line += "  fetch " + total.summary() + "  jobs " + jobs.summary() + "  queue " + queue.summary() +
+                    "  parse " + parse.summary() + "  sort " + sort.summary();
         }
+        if (!draw.empty()) line += "  draw " + draw.summary();
+        return line;
+    }
+
+    // One line per refresh for the --stats log: the refresh's own numbers (in
+    // seconds and bytes) and the rolling draw times
+    void log(FILE* out) const {
+        char stamp[32];
+        time_t now = time(nullptr);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+        fprintf(out,
+                "%s refresh=%lu total=%.6f jobs_cmd=%.6f queue_cmd=%.6f bytes=%llu parse=%.6f records=%zu "
+                "records_per_sec=%.0f sort=%.6f nodes_cmd=%.6f draw_min=%.6f draw_avg=%.6f draw_p99=%.6f rss_mb=%ld\n",
+                stamp, last.refresh, last.totalSeconds, last.jobsSeconds, last.queueSeconds,
+                (unsigned long long)last.bytesRead, last.parseSeconds, last.recordsParsed, recordsPerSecond(),
+                last.sortSeconds, last.nodesSeconds, draw.min(), draw.avg(), draw.p99(), residentMemoryMB());
+    }
+};
+
+// Self-pipe that makes SIGWINCH visible to the UI's poll() loop. The handler then
+// chains to the one installed by ncurses, which queues KEY_RESIZE for getch().
+int resizePipe[2] = {-1, -1};
+struct sigaction ncursesWinchAction;
+
+void onWindowChange(int sig) {
+    int savedErrno = errno;
+    char byte = 1;
+    ssize_t written = write(resizePipe[1], &byte, 1);
+    (void)written;
+    if (ncursesWinchAction.sa_flags & SA_SIGINFO) {
+        if (ncursesWinchAction.sa_sigaction) ncursesWinchAction.sa_sigaction(sig, nullptr, nullptr);
+    } else if (ncursesWinchAction.sa_handler != SIG_DFL && ncursesWinchAction.sa_handler != SIG_IGN) {
+        ncursesWinchAction.sa_handler(sig);
     }
+    errno = savedErrno;
+}
+
+// Set on SIGHUP (terminal closed), so that the UI exits normally and saves its snapshot
+volatile sig_atomic_t hangupReceived = 0;
+
+void onHangup(int) {
+    int savedErrno = errno;
+    hangupReceived = 1;
+    char byte = 1;
+    ssize_t written = write(resizePipe[1], &byte, 1);
+    (void)written;
+    errno = savedErrno;
+}
 
-    // Sort all pending jobs by priority (descending)
-    std::sort(data.allPendingJobs.begin(), data.allPendingJobs.end(),
-              [](const Job& a, const Job& b) { return a.priority > b.priority; });
+void installResizeHandler() {
+    if (pipe2(resizePipe, O_CLOEXEC | O_NONBLOCK) != 0) return;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onWindowChange;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, &ncursesWinchAction);
+    action.sa_handler = onHangup;
+    sigaction(SIGHUP, &action, nullptr);
 }
 
 // UI class
 class SlurmTopUI {
-private:
+public:
     enum View {
         OVERVIEW = 0,
         RUNNING = 1,
         PENDING = 2,
-        ALL = 3
+        ALL = 3,
+        FINISHED = 4
     };
 
+private:
     View currentView;
     int scrollOffset;
+    int cursor;         // Row under the cursor in the table views (index into the view's rows)
     int maxRows;
     SlurmData& data;
+    DataFetcher& fetcher;
     bool running;
     int focusedColumn;  // -1 for none, 0+ for column index
 
+    // Screen areas. Each is redrawn only when what it shows changed, and all of
+    // them are flushed with a single doupdate().
+    WINDOW* headerWin;   // Title and controls bars
+    WINDOW* overviewWin; // Body of the overview
+    WINDOW* titleWin;    // Table title and column headers
+    WINDOW* tableWin;    // Table rows, scrolled with wscrl()
+    WINDOW* detailWin;   // Detail pane between table and footer, only while shown
+    WINDOW* footerWin;   // Scroll indicator
+    WINDOW* statsWin;    // Timings line on the last row, only while shown
+    int screenRows, screenCols; // Terminal size the windows were created for
+
+    // What the windows show since the last draw
+    std::string drawnStatus; // Status text shown in the header
+    int drawnView;           // View in the body windows, -1 when they must be redrawn
+    unsigned long drawnGeneration;
+    int drawnFocus;
+    int drawnOffset;
+    int drawnCursor;
+    std::string drawnFooter;
+    std::string drawnStats;
+
+    bool showStats;          // Toggled with 't'
+    PerformanceStats perf;
+    FILE* statsLog;          // --stats output, or nullptr
+
+    // Structure to hold column widths
+    struct ColumnWidths {
+        int jobId, jobName, account, col4, col5, col6, col7, col8, col9, col10;
+    };
+
+    // Order of a table view: a column (-1 for the default order) and direction
+    struct SortOrder {
+        int column;
+        bool descending;
+
+        SortOrder() : column(-1), descending(false) {}
+        bool operator==(const SortOrder& other) const { return column == other.column && descending == other.descending; }
+        bool operator!=(const SortOrder& other) const { return !(*this == other); }
+    };
+
+    // Per-view rows and column layout, computed once per data snapshot. Rows are
+    // indices into data.jobs and are the table's only copy of the view: a draw
+    // formats just the rows inside the window, so it costs the same for 100 jobs as
+    // for 100k. Each stage is redone only when its input changed: the view's jobs
+    // and column widths with the data, the sorted permutation with the sort order,
+    // and the filtered rows with the filter text. The layout is redone only when
+    // the terminal width or the focused column changes.
+    struct ViewCache {
+        unsigned long generation;       // Data generation the rows were built for
+        std::vector<size_t> viewRows;   // The view's jobs in default order
+        std::vector<size_t> sortedRows; // viewRows in sortOrder
+        SortOrder sortOrder;            // Order sortedRows is in
+        std::vector<size_t> rows;       // sortedRows that match filter, in display order
+        std::string filter;             // Filter rows was built for
+        bool sorted;                    // sortedRows is up to date with generation
+        unsigned long sortedStartVersion; // Start estimates sortedRows was sorted with
+        unsigned long rowsVersion;      // Bumped whenever rows changes
+        int maxWidths[10];              // Widest value (or header) per column
+        int layoutCols;                 // Terminal width the layout was computed for
+        int layoutFocus;                // Focused column the layout was computed for
+        ColumnWidths widths;
+
+        ViewCache() : generation(0), sorted(false), sortedStartVersion(0), rowsVersion(0), layoutCols(-1), layoutFocus(-1) {}
+    };
+
+    unsigned long dataGeneration; // Bumped whenever a new snapshot is swapped in
+    ViewCache viewCaches[5];
+    SortOrder sortOrders[5];      // Chosen with 's' per view
+    std::string filterText;       // '/' filter (lower case), applies to all table views
+    bool editingFilter;           // Keys go into filterText
+    bool groupJobs;               // Toggled with 'g': array and het jobs as one row each
+    StartEstimator startTimes;    // Start column of the Pending view
+    unsigned long startVersion;   // Bumped when new estimates arrived
+    unsigned long drawnStartVersion;
+    bool showDetail;              // Toggled with Enter: details of the job under the cursor
+    JobDetailCache jobDetails;
+    unsigned long detailVersion;  // Bumped when details arrived
+    unsigned long drawnDetailVersion;
+    std::string drawnDetailJob;
+    unsigned long drawnRowsVersion;
+    UsageHistory history;         // Sparklines of the overview
+    HistorySeeder historySeed;    // --history: the hours before this session, from sacct
+    int historyTier;              // Index into kHistoryTiers, cycled with 'h'
+    FinishedJobs finished;        // sacct records of the Finished view
+    std::vector<Job> finishedJobs; // Their latest copy; the Finished view's rows index into it
+
 public:
-    SlurmTopUI(SlurmData& d) : data(d), currentView(OVERVIEW), scrollOffset(0), running(true), focusedColumn(-1) {
-        initscr();
+    SlurmTopUI(SlurmData& d, DataFetcher& f)
+        : currentView(OVERVIEW), scrollOffset(0), cursor(0), maxRows(0), data(d), fetcher(f), running(true), focusedColumn(-1),
+          headerWin(nullptr), overviewWin(nullptr), titleWin(nullptr), tableWin(nullptr), detailWin(nullptr), footerWin(nullptr),
+          statsWin(nullptr), screenRows(0), screenCols(0), drawnView(-1), drawnGeneration(0), drawnFocus(-1),
+          drawnOffset(0), drawnCursor(0), showStats(false), statsLog(nullptr), dataGeneration(1), editingFilter(false),
+          groupJobs(false), startVersion(0), drawnStartVersion(0), showDetail(false), detailVersion(0),
+          drawnDetailVersion(0), drawnRowsVersion(0), historyTier(1) {
+        fetcher.setCapacityWanted(currentView == OVERVIEW);
+        if (!stdscr) initscr(); // Unless the caller set up a screen with newterm() (bench)
         cbreak();
         noecho();
         keypad(stdscr, TRUE);
         curs_set(0);
+        refresh(); // Clear the screen once; stdscr stays untouched from here on so getch() never repaints it
 
         if (has_colors()) {
             start_color();
@@ -357,84 +3898,223 @@ public:
             init_pair(4, COLOR_YELLOW, COLOR_BLACK);  // Pending jobs
             init_pair(5, COLOR_WHITE, COLOR_BLACK);   // Normal text
             init_pair(6, COLOR_RED, COLOR_BLACK);     // Important numbers
+            init_pair(7, COLOR_WHITE, COLOR_RED);     // Warnings in the header
         }
 
-        timeout(100); // Non-blocking input with 100ms timeout
+        nodelay(stdscr, TRUE); // run() waits in poll(); getch() only drains input that is there
+        set_escdelay(25);      // Esc ends filter editing; do not wait a second for an escape sequence
+        installResizeHandler();
     }
 
     ~SlurmTopUI() {
+        destroyWindows();
         endwin();
     }
 
-    // Structure to hold column widths
-    struct ColumnWidths {
-        int jobId, jobName, account, col4, col5, col6, col7, col8, col9;
-    };
+    void destroyWindows() {
+        WINDOW** windows[] = {&headerWin, &overviewWin, &titleWin, &tableWin, &detailWin, &footerWin, &statsWin};
+        for (WINDOW** win : windows) {
+            if (*win) delwin(*win);
+            *win = nullptr;
+        }
+    }
 
-    // Calculate max needed width for a specific column in the current data
-    int getMaxColumnWidth(int columnIndex, const std::vector<Job>& jobs, bool isPendingView) {
-        // Start with header width
-        const char* pendingHeaders[9] = {"JobID", "JobName", "Account", "Reason", "TimeLimit", "GPUs", "GPU Type", "Priority", "Higher"};
-        const char* runningHeaders[8] = {"JobID", "JobName", "Account", "Runtime", "TimeLimit", "GPUs", "GPU Type", "Status"};
-        const char* header = isPendingView ? pendingHeaders[columnIndex] : runningHeaders[columnIndex];
+    // (Re)create the windows for the current terminal size and force a full redraw
+    void createWindows(int rows, int cols) {
+        destroyWindows();
+        wnoutrefresh(stdscr); // Resizing touches stdscr; mark it shown so getch() does not repaint it
+        screenRows = rows;
+        screenCols = cols;
+        int statsRows = showStats ? 1 : 0;
+        int detailRows = showDetailPane() ? kDetailRows : 0;
+        maxRows = std::max(1, rows - 7 - statsRows - detailRows); // Header + controls + title + table header + footer
+
+        headerWin = newwin(2, cols, 0, 0);
+        overviewWin = newwin(std::max(1, rows - 2 - statsRows), cols, 2, 0);
+        titleWin = newwin(4, cols, 2, 0);
+        tableWin = newwin(maxRows, cols, 6, 0);
+        if (detailRows) detailWin = newwin(detailRows, cols, 6 + maxRows, 0);
+        footerWin = newwin(1, cols, std::max(0, rows - 1 - statsRows), 0);
+        if (showStats) statsWin = newwin(1, cols, std::max(0, rows - 1), 0);
+        if (tableWin) {
+            scrollok(tableWin, TRUE);
+            idlok(tableWin, TRUE); // Let ncurses scroll the terminal instead of resending rows
+        }
 
-        int maxWidth = strlen(header); // Start with header width
+        drawnStatus.clear();
+        drawnStats.clear();
+        drawnView = -1;
+    }
 
-        for (const auto& job : jobs) {
-            int len = 0;
+    // Height of the detail pane (a title line and the detailLines()), and how many
+    // rows above and below the cursor are prefetched while it is open
+    static const int kDetailRows = 10;
+    static const int kDetailPrefetch = 2;
+
+    bool showDetailPane() const {
+        return showDetail && currentView != OVERVIEW;
+    }
+
+    // With several users selected, the third table column shows each job's owner
+    // instead of its account
+    bool showOwners() const {
+        return !data.selection.singleUser();
+    }
+
+    const InternedString& ownerOrAccount(const Job& job) const {
+        return showOwners() ? job.user : job.account;
+    }
+
+    // The jobs a view's rows index into: sacct's for the Finished view, squeue's
+    // for the others
+    const std::vector<Job>& jobsOf(View view) const {
+        return view == FINISHED ? finishedJobs : data.jobs;
+    }
+
+    static int columnCount(View view) {
+        return view == PENDING ? 10 : (view == FINISHED ? 9 : 8);
+    }
+
+    // Length of formatSlurmDuration(seconds), without building the string
+    static int durationWidth(long seconds) {
+        switch (seconds) {
+            case kDurationUnlimited: return 9;
+            case kDurationNotSet: return 7;
+            case kDurationPartitionLimit: return 15;
+        }
+        if (seconds < 0) return 7; // INVALID
+        long days = seconds / 86400, hours = (seconds / 3600) % 24;
+        if (days > 0) return digitCount(days) + 9;   // d-hh:mm:ss
+        if (hours > 0) return digitCount(hours) + 6; // h:mm:ss
+        return digitCount((seconds / 60) % 60) + 3;  // m:ss
+    }
+
+    // Number of characters needed to print n in decimal
+    static int digitCount(long n) {
+        int digits = n < 0 ? 2 : 1;
+        for (n = n < 0 ? -(n / 10) : n / 10; n > 0; n /= 10) digits++;
+        return digits;
+    }
+
+    // Members of an array or het job that a view lists, and their GPUs
+    static int groupMembers(const JobGroup& group, View view) {
+        return view == RUNNING ? group.runningJobs : (view == PENDING ? group.pendingJobs : group.jobs);
+    }
+
+    static int groupGpus(const JobGroup& group, View view) {
+        return view == RUNNING ? group.gpusRunning : (view == PENDING ? group.gpusRequested : group.gpus);
+    }
+
+    // In grouped mode, the group that the row of job stands for; nullptr when the
+    // job is shown on its own (not grouped, or the only member in the view)
+    const JobGroup* collapsedGroup(const Job& job, View view) const {
+        if (!groupJobs || job.groupNumber == 0 || view == FINISHED) return nullptr; // Groups are of squeue's jobs
+        auto it = data.groups.find(job.groupNumber);
+        if (it == data.groups.end() || groupMembers(it->second, view) < 2) return nullptr;
+        return &it->second;
+    }
+
+    // Short state names for the state histogram of a collapsed row
+    static const char* stateCode(const std::string& state) {
+        static const char* const codes[][2] = {
+            {"RUNNING", "R"}, {"PENDING", "PD"}, {"COMPLETING", "CG"}, {"COMPLETED", "CD"},
+            {"CONFIGURING", "CF"}, {"SUSPENDED", "S"}, {"FAILED", "F"}, {"CANCELLED", "CA"},
+            {"TIMEOUT", "TO"}, {"PREEMPTED", "PR"}, {"NODE_FAIL", "NF"}, {"OUT_OF_MEMORY", "OOM"}};
+        for (const auto& code : codes) {
+            if (state == code[0]) return code[1];
+        }
+        return state.c_str();
+    }
+
+    // Cells of a collapsed row that differ from its first member's
+    struct GroupCells {
+        std::string jobId;    // "12345 (40)": the array or het job and its members in the view
+        std::string gpus;     // Of those members
+        std::string gpuType;  // Types of all members joined with '+'
+        std::string states;   // State histogram, "R:38 PD:2"
+        std::string priority; // Lowest-highest priority of all members
+    };
+
+    GroupCells groupCells(const Job& job, const JobGroup& group, View view) const {
+        GroupCells cells;
+        cells.jobId = std::to_string(job.groupNumber) + " (" + std::to_string(groupMembers(group, view)) + ")";
+        cells.gpus = std::to_string(groupGpus(group, view));
+        for (const auto& type : group.gpuTypes) {
+            if (!cells.gpuType.empty()) cells.gpuType += '+';
+            cells.gpuType += type.first;
+        }
+        if (cells.gpuType.empty()) cells.gpuType = "N/A";
+        for (const auto& state : group.stateCounts) {
+            if (!cells.states.empty()) cells.states += ' ';
+            cells.states += stateCode(state.first);
+            cells.states += ':' + std::to_string(state.second);
+        }
+        long lowest = group.priorities.begin()->first, highest = group.priorities.rbegin()->first;
+        cells.priority = std::to_string(lowest);
+        if (highest != lowest) cells.priority += "-" + std::to_string(highest);
+        return cells;
+    }
+
+    // Widest value (or header) of every column over the given rows, +1 for spacing
+    // and capped at 50 chars. One pass over the rows; plain rows are measured from
+    // their fields, only the collapsed group rows are formatted (groupCells).
+    void measureColumns(const std::vector<size_t>& jobRows, View view, int* maxWidths) {
+        bool isPendingView = view == PENDING;
+        const char* pendingHeaders[10] = {"JobID", "JobName", "Account", "Reason", "TimeLimit", "GPUs", "GPU Type", "Priority", "Higher", "Start"};
+        const char* runningHeaders[8] = {"JobID", "JobName", "Account", "Runtime", "TimeLimit", "GPUs", "GPU Type", "Status"};
+        const char* finishedHeaders[9] = {"JobID", "JobName", "Account", "Elapsed", "End", "GPUs", "GPU Type", "State", "Exit"};
+        int numColumns = columnCount(view);
+        for (int i = 0; i < numColumns; i++) {
+            maxWidths[i] = strlen(isPendingView ? pendingHeaders[i] : (view == FINISHED ? finishedHeaders[i] : runningHeaders[i]));
+        }
+        if (showOwners()) maxWidths[2] = strlen("User");
+
+        auto widen = [maxWidths](int column, int len) { maxWidths[column] = std::max(maxWidths[column], len); };
+        const std::vector<Job>& jobs = jobsOf(view);
+        for (size_t row : jobRows) {
+            const Job& job = jobs[row];
+            widen(0, job.jobId.length());
+            widen(1, job.jobName.length());
+            widen(2, ownerOrAccount(job).length());
+            widen(4, view == FINISHED ? kStartTimeWidth : durationWidth(job.timeLimitSeconds));
+            widen(5, digitCount(job.gpuCount));
+            widen(6, job.gpuType.length());
+            if (view == FINISHED) widen(8, job.reason.length());
             if (isPendingView) {
-                // Pending view has 9 columns
-                switch (columnIndex) {
-                    case 0: len = job.jobId.length(); break;
-                    case 1: len = job.jobName.length(); break;
-                    case 2: len = job.account.length(); break;
-                    case 3: len = job.reason.length(); break;
-                    case 4: len = job.timeLimit.length(); break;
-                    case 5: len = std::to_string(job.gpuCount).length(); break;
-                    case 6: len = job.gpuType.length(); break;
-                    case 7: len = std::to_string(job.priority).length(); break;
-                    case 8:
-                        // For "Higher" column, count jobs with higher priority
-                        int higherCount = 0;
-                        for (const auto& other : data.allPendingJobs) {
-                            if (other.priority > job.priority) higherCount++;
-                        }
-                        len = std::to_string(higherCount).length();
-                        break;
-                }
+                widen(3, job.reason.length());
+                widen(7, digitCount(job.priority));
+                widen(8, data.pendingQueueLoaded ? digitCount(job.higherCount) : 3); // "..." while the queue loads
+                widen(9, kStartTimeWidth); // Estimates arrive later; keep the column steady
             } else {
-                // Running view has 8 columns
-                switch (columnIndex) {
-                    case 0: len = job.jobId.length(); break;
-                    case 1: len = job.jobName.length(); break;
-                    case 2: len = job.account.length(); break;
-                    case 3: len = job.runtime.length(); break;
-                    case 4: len = job.timeLimit.length(); break;
-                    case 5: len = std::to_string(job.gpuCount).length(); break;
-                    case 6: len = job.gpuType.length(); break;
-                    case 7: len = job.state.length(); break;
-                }
+                widen(3, durationWidth(job.runtimeSeconds));
+                widen(7, job.state.length());
+            }
+            if (const JobGroup* group = collapsedGroup(job, view)) {
+                GroupCells cells = groupCells(job, *group, view);
+                widen(0, cells.jobId.length());
+                widen(5, cells.gpus.length());
+                widen(6, cells.gpuType.length());
+                widen(7, isPendingView ? cells.priority.length() : cells.states.length());
             }
-            maxWidth = std::max(maxWidth, len);
         }
 
-        return std::min(maxWidth + 1, 50); // +1 for spacing, cap at 50 chars max
+        for (int i = 0; i < numColumns; i++) maxWidths[i] = std::min(maxWidths[i] + 1, 50);
     }
 
-    // Calculate dynamic column widths based on focused column
-    ColumnWidths calculateColumnWidths(int terminalCols, int numColumns, const int* defaultWidths,
-                                      const std::vector<Job>& jobs, bool isPendingView) {
+    // Calculate dynamic column widths based on focused column, from the per-column
+    // maximum widths (see measureColumns)
+    ColumnWidths calculateColumnWidths(int terminalCols, int numColumns, const int* maxWidths) {
         ColumnWidths widths;
-        int* widthArray[9] = {&widths.jobId, &widths.jobName, &widths.account,
-                              &widths.col4, &widths.col5, &widths.col6,
-                              &widths.col7, &widths.col8, &widths.col9};
+        int* widthArray[10] = {&widths.jobId, &widths.jobName, &widths.account,
+                               &widths.col4, &widths.col5, &widths.col6,
+                               &widths.col7, &widths.col8, &widths.col9, &widths.col10};
 
         if (focusedColumn >= 0 && focusedColumn < numColumns) {
             // FOCUSED MODE: Expand focused column, distribute remaining to others
             int availableWidth = terminalCols - (numColumns - 1) - 2; // Subtract separators and margin
 
             // Calculate needed width for focused column (including header and brackets)
-            int focusedNeededWidth = getMaxColumnWidth(focusedColumn, jobs, isPendingView);
+            int focusedNeededWidth = maxWidths[focusedColumn];
             focusedNeededWidth += 2; // Add space for brackets [ ]
 
             // Focused column gets: min(needed_width, full_width)
@@ -449,7 +4129,7 @@ public:
             // Each other column gets: min(required_width, proportional_share)
             for (int i = 0; i < numColumns; i++) {
                 if (i != focusedColumn) {
-                    int requiredWidth = getMaxColumnWidth(i, jobs, isPendingView);
+                    int requiredWidth = maxWidths[i];
                     *widthArray[i] = std::min(requiredWidth, widthPerOtherColumn);
                 }
             }
@@ -467,7 +4147,7 @@ public:
                 // Give leftover to columns that were capped
                 for (int i = 0; i < numColumns && leftover > 0; i++) {
                     if (i != focusedColumn) {
-                        int requiredWidth = getMaxColumnWidth(i, jobs, isPendingView);
+                        int requiredWidth = maxWidths[i];
                         int canGrow = requiredWidth - *widthArray[i];
                         if (canGrow > 0) {
                             int toAdd = std::min(canGrow, leftover);
@@ -490,9 +4170,9 @@ public:
 
             // Calculate required width for each column
             int totalRequired = 0;
-            int requiredWidths[9];  // Changed from 8 to 9 to support pending view
+            int requiredWidths[10]; // Up to the pending view's 10 columns
             for (int i = 0; i < numColumns; i++) {
-                requiredWidths[i] = getMaxColumnWidth(i, jobs, isPendingView);
+                requiredWidths[i] = maxWidths[i];
                 totalRequired += requiredWidths[i];
             }
 
@@ -533,365 +4213,869 @@ public:
         return widths;
     }
 
-    void drawHeader() {
-        int rows, cols;
-        getmaxyx(stdscr, rows, cols);
+    // Rows and column maxima for a table view, rebuilt only for new data
+    ViewCache& viewCache(View view) {
+        ViewCache& cache = viewCaches[view];
+        if (cache.generation != dataGeneration) {
+            cache.viewRows.clear();
+            const std::vector<Job>& jobs = jobsOf(view);
+            for (size_t i = 0; i < jobs.size(); i++) {
+                JobState state = jobs[i].getState();
+                if (view == ALL || view == FINISHED || // Finished jobs arrive most recently ended first
+                    (view == RUNNING && state == JobState::RUNNING) ||
+                    (view == PENDING && state == JobState::PENDING)) {
+                    cache.viewRows.push_back(i);
+                }
+            }
+
+            if (view == PENDING) {
+                // Sort by priority
+                std::stable_sort(cache.viewRows.begin(), cache.viewRows.end(),
+                                 [this](size_t a, size_t b) { return data.jobs[a].priority > data.jobs[b].priority; });
+            }
+
+            if (groupJobs) {
+                // The first member of each array or het job stands for all of them
+                std::unordered_set<unsigned long> shown;
+                cache.viewRows.erase(std::remove_if(cache.viewRows.begin(), cache.viewRows.end(),
+                                                    [this, view, &jobs, &shown](size_t row) {
+                                                        const Job& job = jobs[row];
+                                                        return collapsedGroup(job, view) && !shown.insert(job.groupNumber).second;
+                                                    }),
+                                     cache.viewRows.end());
+            }
+
+            // Widths over the whole view, so that columns stay put while filtering
+            measureColumns(cache.viewRows, view, cache.maxWidths);
+
+            cache.generation = dataGeneration;
+            cache.sorted = false;
+            cache.layoutCols = -1;
+        }
+
+        // Sorted by Start, the order also changes as estimates arrive between refreshes
+        if (view == PENDING && sortOrders[view].column == 9 && cache.sortedStartVersion != startVersion) {
+            cache.sorted = false;
+        }
+
+        bool resorted = false;
+        if (!cache.sorted || cache.sortOrder != sortOrders[view]) {
+            cache.sortOrder = sortOrders[view];
+            cache.sortedRows = cache.viewRows;
+            sortRows(cache.sortedRows, view, cache.sortOrder);
+            cache.sorted = true;
+            cache.sortedStartVersion = startVersion;
+            resorted = true;
+        }
+
+        if (resorted || cache.filter != filterText) {
+            // A longer filter only matches a subset of what the shorter one matched,
+            // so typing narrows the previous rows instead of scanning the whole view
+            bool narrowing = !resorted && !cache.filter.empty() && filterText.find(cache.filter) != std::string::npos;
+            if (!narrowing) cache.rows = cache.sortedRows;
+            if (!filterText.empty()) {
+                const std::vector<Job>& jobs = jobsOf(view);
+                cache.rows.erase(std::remove_if(cache.rows.begin(), cache.rows.end(),
+                                                [this, &jobs](size_t row) { return !matchesFilter(jobs[row]); }),
+                                 cache.rows.end());
+            }
+            cache.filter = filterText;
+            cache.rowsVersion++;
+        }
+        return cache;
+    }
+
+    // Numeric sort key of a job for the given column. Text columns are ordered by
+    // the rank of their value among distinct values (see sortRows).
+    long numericSortKey(const Job& job, View view, int column) {
+        const JobGroup* group = collapsedGroup(job, view);
+        switch (column) {
+            case 0: return job.jobNumber;
+            case 3: return view == PENDING ? 0 : job.runtimeSeconds;
+            case 4: return view == FINISHED ? (long)job.endTime : job.timeLimitSeconds;
+            case 5: return group ? groupGpus(*group, view) : job.gpuCount;
+            case 7: return view == PENDING ? job.priority : 0;
+            case 8: return job.higherCount;
+            case 9: {
+                time_t start; // Jobs without an estimate (yet) go last
+                return startTimes.lookup(job.jobId, start) && start > 0 ? (long)start : LONG_MAX;
+            }
+        }
+        return 0;
+    }
+
+    // Columns that show interned text: owner or account, reason, GPU type, status,
+    // exit code
+    static bool isTextColumn(View view, int column) {
+        return column == 2 || column == 6 || column == (view == PENDING ? 3 : 7) || (view == FINISHED && column == 8);
+    }
+
+    const InternedString& textSortKey(const Job& job, View view, int column) {
+        if (column == 2) return ownerOrAccount(job);
+        if (column == 6) return job.gpuType;
+        if (view == FINISHED && column == 8) return job.reason;
+        return view == PENDING ? job.reason : job.state;
+    }
+
+    // Stable sort of rows by a column. Every row gets a numeric key first (fields
+    // that were parsed into numbers already, or the rank of an interned value), so
+    // that the sort compares integers and never parses or compares strings again.
+    // Only the job name column compares text.
+    void sortRows(std::vector<size_t>& rows, View view, SortOrder order) {
+        if (order.column < 0 || rows.empty()) return;
+        bool descending = order.descending;
+        const std::vector<Job>& jobs = jobsOf(view);
+
+        if (order.column == 1) {
+            std::stable_sort(rows.begin(), rows.end(), [&jobs, descending](size_t a, size_t b) {
+                int cmp = jobs[a].jobName.compare(jobs[b].jobName);
+                return descending ? cmp > 0 : cmp < 0;
+            });
+            return;
+        }
+
+        std::vector<std::pair<long, size_t>> keyed(rows.size());
+        if (isTextColumn(view, order.column)) {
+            std::unordered_map<const std::string*, long> rank; // Interned value -> position in sorted order
+            for (size_t row : rows) rank[&textSortKey(jobs[row], view, order.column).str()] = 0;
+            std::vector<const std::string*> values;
+            for (const auto& entry : rank) values.push_back(entry.first);
+            std::sort(values.begin(), values.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+            for (size_t i = 0; i < values.size(); i++) rank[values[i]] = i;
+            for (size_t i = 0; i < rows.size(); i++) {
+                keyed[i] = std::make_pair(rank[&textSortKey(jobs[rows[i]], view, order.column).str()], rows[i]);
+            }
+        } else {
+            for (size_t i = 0; i < rows.size(); i++) {
+                keyed[i] = std::make_pair(numericSortKey(jobs[rows[i]], view, order.column), rows[i]);
+            }
+        }
+        std::stable_sort(keyed.begin(), keyed.end(),
+                         [descending](const std::pair<long, size_t>& a, const std::pair<long, size_t>& b) {
+                             return descending ? a.first > b.first : a.first < b.first;
+                         });
+        for (size_t i = 0; i < rows.size(); i++) rows[i] = keyed[i].second;
+    }
+
+    // Case-insensitive substring test; needle is lower case
+    static bool containsFolded(StringView haystack, const std::string& needle) {
+        if (needle.size() > haystack.size()) return false;
+        for (size_t i = 0; i + needle.size() <= haystack.size(); i++) {
+            size_t j = 0;
+            while (j < needle.size() && tolower(static_cast<unsigned char>(haystack[i + j])) == needle[j]) j++;
+            if (j == needle.size()) return true;
+        }
+        return false;
+    }
+
+    // Whether the '/' filter matches the job's id, name, owner, account, GPU type,
+    // state or reason
+    bool matchesFilter(const Job& job) {
+        return containsFolded(job.jobId, filterText) || containsFolded(job.jobName, filterText) ||
+               containsFolded(job.account.str(), filterText) || containsFolded(job.user.str(), filterText) ||
+               containsFolded(job.gpuType.str(), filterText) || containsFolded(job.state.str(), filterText) ||
+               containsFolded(job.reason.str(), filterText);
+    }
+
+    // Column widths for a view, recomputed only on resize or focus change
+    const ColumnWidths& columnLayout(ViewCache& cache, int terminalCols, int numColumns) {
+        if (cache.layoutCols != terminalCols || cache.layoutFocus != focusedColumn) {
+            cache.widths = calculateColumnWidths(terminalCols, numColumns, cache.maxWidths);
+            cache.layoutCols = terminalCols;
+            cache.layoutFocus = focusedColumn;
+        }
+        return cache.widths;
+    }
+
+    // Fetch status shown in the header: loading, refreshing or age of the data
+    std::string statusText() {
+        std::string failure;
+        double retrySeconds;
+        if (fetcher.lastFailure(failure, retrySeconds)) return failureText(failure, retrySeconds);
+        if (!data.loaded) return "Loading...";
+        if (data.stale) {
+            long age = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now() - data.updatedAt).count();
+            return "Stale, " + formatAge(age) + " old - refreshing...";
+        }
+        if (!data.complete) return data.pendingQueueLoaded ? "Loading jobs..." : "Loading queue...";
+        if (fetcher.isFetching()) return "Refreshing...";
+        long age = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - data.updatedAt).count();
+        std::string status = "Updated " + formatAge(age) + " ago";
+        if (fetcher.autoRefreshEnabled()) {
+            status += ", every " + formatAge((long)(fetcher.refreshInterval() + 0.5));
+        }
+        return status;
+    }
+
+    // Status while refreshes fail: what is shown instead, how old it is, and why
+    std::string failureText(const std::string& failure, double retrySeconds) {
+        std::string status = "STALE";
+        if (data.loaded && data.complete) {
+            long age = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now() - data.updatedAt).count();
+            status += ", " + formatAge(age) + " old";
+        } else {
+            status = "NO DATA";
+        }
+        status += ": " + failure;
+        if (fetcher.isFetching() || retrySeconds <= 0) return status + " - retrying...";
+        return status + " - retry in " + formatAge((long)retrySeconds + 1);
+    }
 
-        attron(COLOR_PAIR(1) | A_BOLD);
-        mvhline(0, 0, ' ', cols);
-        mvprintw(0, 2, "SLURM Top - User: %s", data.username.c_str());
+    void drawHeader() {
+        std::string status = statusText();
+        if (status == drawnStatus) return;
+        drawnStatus = status;
+
+        WINDOW* win = headerWin;
+        int cols = screenCols;
+
+        wattron(win, COLOR_PAIR(1) | A_BOLD);
+        mvwhline(win, 0, 0, ' ', cols);
+        std::string title = "SLURM Top - " + data.selection.describe() + "  ";
+        mvwprintw(win, 0, 2, "%s", title.c_str());
+        std::string failure;
+        double retrySeconds;
+        bool failing = fetcher.lastFailure(failure, retrySeconds);
+        if (failing) wattrset(win, COLOR_PAIR(7) | A_BOLD);
+        wprintw(win, "[%s]", drawnStatus.c_str());
+        if (failing) wattrset(win, COLOR_PAIR(1) | A_BOLD);
 
         // View indicators
         int viewX = cols - 60;
         if (viewX < 40) viewX = 40;
 
-        mvprintw(0, viewX, "[1]Overview [2]Running [3]Pending [4]All");
-        attroff(COLOR_PAIR(1) | A_BOLD);
+        mvwprintw(win, 0, viewX, "[1]Overview [2]Running [3]Pending [4]All [5]Finished");
+        wattroff(win, COLOR_PAIR(1) | A_BOLD);
 
         // Controls bar
-        attron(COLOR_PAIR(1));
-        mvhline(1, 0, ' ', cols);
-        mvprintw(1, 2, "Controls: Up/Down:Scroll  Left/Right:Focus Column  PgUp/PgDn:Page  R:Refresh  Q:Quit");
-        attroff(COLOR_PAIR(1));
+        wattron(win, COLOR_PAIR(1));
+        mvwhline(win, 1, 0, ' ', cols);
+        mvwprintw(win, 1, 2, "Controls: Up/Down:Move  Left/Right:Column  S:Sort  /:Filter  G:Group  Enter:Details  PgUp/PgDn  Home/End  R:Refresh  T:Stats  Q:Quit");
+        wattroff(win, COLOR_PAIR(1));
+        wnoutrefresh(win);
     }
 
     void drawOverview() {
-        int rows, cols;
-        getmaxyx(stdscr, rows, cols);
+        // The overview only changes with the data
+        if (drawnView == OVERVIEW && drawnGeneration == dataGeneration) return;
 
-        int y = 3;
+        WINDOW* win = overviewWin;
+        werase(win);
+        int y = 1;
 
-        attron(COLOR_PAIR(2) | A_BOLD);
-        mvprintw(y++, 2, "JOB OVERVIEW");
-        attroff(COLOR_PAIR(2) | A_BOLD);
+        wattron(win, COLOR_PAIR(2) | A_BOLD);
+        mvwprintw(win, y++, 2, "JOB OVERVIEW");
+        wattroff(win, COLOR_PAIR(2) | A_BOLD);
         y++;
 
-        mvprintw(y++, 4, "Total Jobs: %d", data.totalJobs);
+        if (!data.loaded) {
+            mvwprintw(win, y++, 4, "Loading job data...");
+            wnoutrefresh(win);
+            return;
+        }
+
+        mvwprintw(win, y++, 4, "Total Jobs: %d", data.totalJobs);
 
-        attron(COLOR_PAIR(3));
-        mvprintw(y++, 4, "Running:    %d", data.runningJobs);
-        attroff(COLOR_PAIR(3));
+        wattron(win, COLOR_PAIR(3));
+        mvwprintw(win, y++, 4, "Running:    %-6d %s", data.runningJobs, formatTresTotals(data.runningTres).c_str());
+        wattroff(win, COLOR_PAIR(3));
 
-        attron(COLOR_PAIR(4));
-        mvprintw(y++, 4, "Pending:    %d", data.pendingJobs);
-        attroff(COLOR_PAIR(4));
+        wattron(win, COLOR_PAIR(4));
+        mvwprintw(win, y++, 4, "Pending:    %-6d %s", data.pendingJobs, formatTresTotals(data.pendingTres).c_str());
+        wattroff(win, COLOR_PAIR(4));
 
         y += 2;
 
+        // Cluster GPUs to the right of the user's numbers when there is room, else in line
+        bool capacityBeside = screenCols - kCapacityWidth - 2 >= kOverviewWidth;
+        int capacityEnd = capacityBeside ? drawCapacity(win, 1, screenCols - kCapacityWidth - 2) : 0;
+
         if (!data.gpuTypeCount.empty()) {
-            attron(COLOR_PAIR(2) | A_BOLD);
-            mvprintw(y++, 2, "RUNNING - GPU ALLOCATIONS");
-            attroff(COLOR_PAIR(2) | A_BOLD);
+            wattron(win, COLOR_PAIR(2) | A_BOLD);
+            mvwprintw(win, y++, 2, "RUNNING - GPU ALLOCATIONS");
+            wattroff(win, COLOR_PAIR(2) | A_BOLD);
             y++;
 
             int totalGPUs = 0;
             for (const auto& pair : data.gpuTypeCount) {
-                attron(COLOR_PAIR(3));
-                mvprintw(y++, 4, "%-15s: %d GPUs", pair.first.c_str(), pair.second);
-                attroff(COLOR_PAIR(3));
+                wattron(win, COLOR_PAIR(3));
+                mvwprintw(win, y++, 4, "%-15s: %d GPUs", pair.first.c_str(), pair.second);
+                wattroff(win, COLOR_PAIR(3));
                 totalGPUs += pair.second;
             }
 
             y++;
-            attron(COLOR_PAIR(6) | A_BOLD);
-            mvprintw(y++, 4, "Total Running:  %d GPUs", totalGPUs);
-            attroff(COLOR_PAIR(6) | A_BOLD);
+            wattron(win, COLOR_PAIR(6) | A_BOLD);
+            mvwprintw(win, y++, 4, "Total Running:  %d GPUs", totalGPUs);
+            wattroff(win, COLOR_PAIR(6) | A_BOLD);
 
             y += 2;
         }
 
         if (!data.gpuTypeRequested.empty()) {
-            attron(COLOR_PAIR(2) | A_BOLD);
-            mvprintw(y++, 2, "PENDING - GPU REQUESTS");
-            attroff(COLOR_PAIR(2) | A_BOLD);
+            wattron(win, COLOR_PAIR(2) | A_BOLD);
+            mvwprintw(win, y++, 2, "PENDING - GPU REQUESTS");
+            wattroff(win, COLOR_PAIR(2) | A_BOLD);
             y++;
 
             int totalRequested = 0;
             for (const auto& pair : data.gpuTypeRequested) {
-                attron(COLOR_PAIR(4));
-                mvprintw(y++, 4, "%-15s: %d GPUs", pair.first.c_str(), pair.second);
-                attroff(COLOR_PAIR(4));
+                wattron(win, COLOR_PAIR(4));
+                mvwprintw(win, y++, 4, "%-15s: %d GPUs", pair.first.c_str(), pair.second);
+                wattroff(win, COLOR_PAIR(4));
                 totalRequested += pair.second;
             }
 
             y++;
-            attron(COLOR_PAIR(6) | A_BOLD);
-            mvprintw(y++, 4, "Total Requested: %d GPUs", totalRequested);
-            attroff(COLOR_PAIR(6) | A_BOLD);
+            wattron(win, COLOR_PAIR(6) | A_BOLD);
+            mvwprintw(win, y++, 4, "Total Requested: %d GPUs", totalRequested);
+            wattroff(win, COLOR_PAIR(6) | A_BOLD);
+            y += 2;
         }
-    }
 
-    void drawJobTable(const std::vector<Job>& jobs, const std::string& title, int colorPair) {
-        int rows, cols;
-        getmaxyx(stdscr, rows, cols);
-        maxRows = rows - 6; // Header + controls + title + table header + footer
+        if (capacityBeside) y = std::max(y, capacityEnd);
+        else y = drawCapacity(win, y, 2);
+        y = drawHistory(win, y, 2);
 
-        int y = 3;
+        if (showOwners()) {
+            y = drawGroupUsage(win, y, "BY USER", data.userUsage);
+            drawGroupUsage(win, y + 1, "BY ACCOUNT", data.accountUsage);
+        }
+        wnoutrefresh(win);
+    }
 
-        attron(COLOR_PAIR(2) | A_BOLD);
-        mvprintw(y++, 2, "%s (%zu jobs)", title.c_str(), jobs.size());
-        attroff(COLOR_PAIR(2) | A_BOLD);
-        y++;
+    // Widths of the overview's left column (the per-user tables) and of the
+    // cluster GPU pane
+    static const int kOverviewWidth = 78;
+    static const int kCapacityWidth = 58;
+
+    // Sparkline width and the labels left of it
+    static const int kHistoryColumns = 60;
+    static const int kHistoryLabelWidth = 16;
+
+    // One sparkline row; skipped for GPU types that had none in the shown range
+    int drawSparkline(WINDOW* win, int y, int x, const std::string& label, const TimeSeries& series, int width,
+                      time_t now, int color, bool skipEmpty) {
+        double latest, peak;
+        std::string line = sparkline(series, historyTier, now, width, latest, peak);
+        if (skipEmpty && peak <= 0) return y;
+        mvwprintw(win, y, x, "%-*.*s", kHistoryLabelWidth, kHistoryLabelWidth, label.c_str());
+        wattron(win, COLOR_PAIR(color));
+        waddnstr(win, line.c_str(), (int)line.size());
+        wattroff(win, COLOR_PAIR(color));
+        wprintw(win, " %5.0f  (peak %.0f)", latest, peak);
+        return y + 1;
+    }
 
-        // Calculate dynamic column widths
-        int defaultWidths[8] = {10, 16, 16, 10, 10, 5, 10, 10};
-        ColumnWidths w = calculateColumnWidths(cols, 8, defaultWidths, jobs, false);
-
-        // Table header with dynamic widths and focus indicators
-        const char* headers[8] = {"JobID", "JobName", "Account", "Runtime", "TimeLimit", "GPUs", "GPU Type", "Status"};
-        int widths[8] = {w.jobId, w.jobName, w.account, w.col4, w.col5, w.col6, w.col7, w.col8};
-
-        move(y, 0);
-        clrtoeol();
-        attron(A_BOLD);
-        int xpos = 0;
-        for (int i = 0; i < 8; i++) {
-            move(y, xpos);
-            // Add focus indicator
-            if (focusedColumn == i) {
-                attron(COLOR_PAIR(6)); // Red color for focused
-                // Format: [HeaderName] constrained to column width
-                char headerBuf[64];
-                snprintf(headerBuf, sizeof(headerBuf), "[%s]", headers[i]);
-                printw("%-*.*s", widths[i], widths[i], headerBuf);
-                attroff(COLOR_PAIR(6));
-            } else {
-                // Format: HeaderName constrained to column width
-                printw("%-*.*s", widths[i], widths[i], headers[i]);
-            }
-            xpos += widths[i] + 1; // +1 for space separator
-        }
-        attroff(A_BOLD);
-        y++;
+    // Running and pending jobs and GPUs per type over the last kHistoryColumns
+    // buckets of the chosen tier. Returns the next free line.
+    int drawHistory(WINDOW* win, int y, int x) {
+        int lastLine = getmaxy(win) - 1;
+        int width = std::min(kHistoryColumns, screenCols - x - kHistoryLabelWidth - 24);
+        if (history.empty() || width < 10 || y + 4 > lastLine) return y;
+
+        const HistoryTier& tier = kHistoryTiers[historyTier];
+        wattron(win, COLOR_PAIR(2) | A_BOLD);
+        mvwprintw(win, y, x, "HISTORY");
+        wattroff(win, COLOR_PAIR(2) | A_BOLD);
+        wprintw(win, "  last %s, %s per column (H: change)", formatAge(width * tier.seconds).c_str(),
+                formatAge(tier.seconds).c_str());
+        y += 2;
 
-        // Build format string for data rows
-        char fmt[256];
-        snprintf(fmt, sizeof(fmt), "%%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds",
-                 w.jobId, w.jobId, w.jobName, w.jobName, w.account, w.account,
-                 w.col4, w.col4, w.col5, w.col5, w.col6, w.col6, w.col7, w.col7, w.col8, w.col8);
+        time_t now = time(nullptr);
+        if (y < lastLine) y = drawSparkline(win, y, x + 2, "Running jobs", history.running(), width, now, 3, false);
+        for (const auto& type : history.runningGpus()) {
+            if (y >= lastLine) break;
+            y = drawSparkline(win, y, x + 2, "  " + type.first + " GPUs", type.second, width, now, 3, true);
+        }
+        if (y < lastLine) y = drawSparkline(win, y, x + 2, "Pending jobs", history.pending(), width, now, 4, false);
+        for (const auto& type : history.requestedGpus()) {
+            if (y >= lastLine) break;
+            y = drawSparkline(win, y, x + 2, "  " + type.first + " GPUs", type.second, width, now, 4, true);
+        }
+        return y + 1;
+    }
 
-        // Table rows
-        int displayedRows = 0;
-        for (size_t i = scrollOffset; i < jobs.size() && displayedRows < maxRows; i++, displayedRows++) {
-            const Job& job = jobs[i];
-
-            attron(COLOR_PAIR(colorPair));
-
-            // Prepare data fields (use full strings for focused column)
-            std::string jobId = (focusedColumn == 0) ? job.jobId :
-                               (job.jobId.length() > (size_t)w.jobId ? job.jobId.substr(0, w.jobId) : job.jobId);
-            std::string jobName = (focusedColumn == 1) ? job.jobName :
-                                 (job.jobName.length() > (size_t)w.jobName ? job.jobName.substr(0, w.jobName - 3) + "..." : job.jobName);
-            std::string account = (focusedColumn == 2) ? job.account :
-                                 (job.account.length() > (size_t)w.account ? job.account.substr(0, w.account - 3) + "..." : job.account);
-            std::string runtime = (focusedColumn == 3) ? job.runtime :
-                                 (job.runtime.length() > (size_t)w.col4 ? job.runtime.substr(0, w.col4) : job.runtime);
-            std::string timeLimit = (focusedColumn == 4) ? job.timeLimit :
-                                   (job.timeLimit.length() > (size_t)w.col5 ? job.timeLimit.substr(0, w.col5) : job.timeLimit);
-            std::string gpuType = (focusedColumn == 6) ? job.gpuType :
-                                 (job.gpuType.length() > (size_t)w.col7 ? job.gpuType.substr(0, w.col7 - 3) + "..." : job.gpuType);
-            std::string state = (focusedColumn == 7) ? job.state :
-                               (job.state.length() > (size_t)w.col8 ? job.state.substr(0, w.col8) : job.state);
-
-            // Format entire line into buffer first with dynamic widths
-            char fullLine[512];
-            snprintf(fullLine, sizeof(fullLine), fmt,
-                   jobId.c_str(),
-                   jobName.c_str(),
-                   account.c_str(),
-                   runtime.c_str(),
-                   timeLimit.c_str(),
-                   std::to_string(job.gpuCount).c_str(),
-                   job.gpuCount > 0 ? gpuType.c_str() : "N/A",
-                   state.c_str());
-
-            // HARD truncate to terminal width
-            if ((int)strlen(fullLine) > cols - 2) {
-                fullLine[cols - 2] = '\0';
-            }
-
-            move(y, 0);
-            clrtoeol();
-            addstr(fullLine);
-
-            attroff(COLOR_PAIR(colorPair));
+    // Cluster GPUs per type (from sinfo or libslurm) with the user's own pending
+    // requests beside the idle count. Returns the next free line.
+    int drawCapacity(WINDOW* win, int y, int x) {
+        int lastLine = getmaxy(win) - 1;
+        if (!data.capacityLoaded || data.gpuCapacity.empty() || y + 4 > lastLine) return y;
+
+        wattron(win, COLOR_PAIR(2) | A_BOLD);
+        mvwprintw(win, y++, x, "CLUSTER GPUS");
+        wattroff(win, COLOR_PAIR(2) | A_BOLD);
+        wattron(win, A_BOLD);
+        mvwprintw(win, y++, x + 2, "%-14s %7s %7s %7s %7s %8s", "", "Total", "Alloc", "Idle", "Unavail", "My req");
+        wattroff(win, A_BOLD);
+
+        GpuCapacity sum;
+        for (const auto& type : data.gpuCapacity) {
+            if (y >= lastLine) break;
+            const GpuCapacity& gpus = type.second;
+            auto requested = data.gpuTypeRequested.find(type.first);
+            mvwprintw(win, y, x + 2, "%-14.14s %7d %7d ", type.first.c_str(), gpus.total, gpus.allocated);
+            wattron(win, COLOR_PAIR(gpus.idle() > 0 ? 3 : 6));
+            wprintw(win, "%7d", gpus.idle());
+            wattroff(win, COLOR_PAIR(gpus.idle() > 0 ? 3 : 6));
+            wprintw(win, " %7d %8d", gpus.unavailable, requested == data.gpuTypeRequested.end() ? 0 : requested->second);
             y++;
+            sum.total += gpus.total;
+            sum.allocated += gpus.allocated;
+            sum.unavailable += gpus.unavailable;
+        }
+        if (y < lastLine) {
+            wattron(win, A_BOLD);
+            mvwprintw(win, y++, x + 2, "%-14s %7d %7d %7d %7d", "Total", sum.total, sum.allocated, sum.idle(),
+                      sum.unavailable);
+            wattroff(win, A_BOLD);
         }
+        return y + 1;
+    }
 
-        // Scroll indicator
-        if (jobs.size() > maxRows) {
-            mvprintw(rows - 1, 2, "Showing %d-%zu of %zu (Scroll: %d%%)",
-                     scrollOffset + 1,
-                     std::min(scrollOffset + maxRows, (int)jobs.size()),
-                     jobs.size(),
-                     (int)((scrollOffset * 100) / std::max(1, (int)jobs.size() - maxRows)));
+    // Per-user or per-account table of the overview, busiest (most running GPUs)
+    // first and cut to the window height. Returns the next free line.
+    int drawGroupUsage(WINDOW* win, int y, const char* title, const std::map<std::string, GroupUsage>& groups) {
+        int lastLine = getmaxy(win) - 1;
+        if (groups.empty() || y + 3 > lastLine) return y;
+
+        wattron(win, COLOR_PAIR(2) | A_BOLD);
+        mvwprintw(win, y++, 2, "%s", title);
+        wattroff(win, COLOR_PAIR(2) | A_BOLD);
+        wattron(win, A_BOLD);
+        mvwprintw(win, y++, 4, "%-20s %8s %8s %10s %10s %8s", "", "Running", "Pending", "GPUs run", "GPUs req", "CPUs");
+        wattroff(win, A_BOLD);
+
+        std::vector<const std::pair<const std::string, GroupUsage>*> order;
+        for (const auto& group : groups) order.push_back(&group);
+        std::sort(order.begin(), order.end(), [](const std::pair<const std::string, GroupUsage>* a,
+                                                 const std::pair<const std::string, GroupUsage>* b) {
+            if (a->second.gpusRunning != b->second.gpusRunning) return a->second.gpusRunning > b->second.gpusRunning;
+            if (a->second.runningJobs != b->second.runningJobs) return a->second.runningJobs > b->second.runningJobs;
+            return a->first < b->first;
+        });
+
+        for (size_t i = 0; i < order.size(); i++) {
+            if (y == lastLine && i + 1 < order.size()) {
+                mvwprintw(win, y++, 4, "... and %zu more", order.size() - i);
+                break;
+            }
+            const GroupUsage& usage = order[i]->second;
+            mvwprintw(win, y++, 4, "%-20.20s %8d %8d %10d %10d %8ld", order[i]->first.c_str(), usage.runningJobs,
+                      usage.pendingJobs, usage.gpusRunning, usage.gpusRequested, usage.runningTres.cpus);
         }
+        return y;
     }
 
-    void drawPendingView() {
-        int rows, cols;
-        getmaxyx(stdscr, rows, cols);
-        maxRows = rows - 6;
+    // Append text to line, left-aligned in a cell of the given width. Text that does
+    // not fit is cut, ending in "..." when ellipsize is set.
+    static void appendCell(std::string& line, StringView text, int width, bool ellipsize) {
+        if (width <= 0) return;
+        size_t cell = width;
+        if (text.size() <= cell) {
+            line.append(text.data(), text.size());
+            line.append(cell - text.size(), ' ');
+        } else if (ellipsize && cell >= 3) {
+            line.append(text.data(), cell - 3);
+            line.append("...");
+        } else {
+            line.append(text.data(), cell);
+        }
+    }
+
+    // Format one table row for the given layout, cut to the terminal width
+    std::string formatRow(View view, const Job& job, const ColumnWidths& w, int terminalCols) {
+        const int widths[10] = {w.jobId, w.jobName, w.account, w.col4, w.col5, w.col6, w.col7, w.col8, w.col9, w.col10};
+        std::string runtime = view == PENDING ? std::string() : formatSlurmDuration(job.runtimeSeconds);
+        std::string timeLimit = view == FINISHED ? formatTableTime(job.endTime, time(nullptr))
+                                                 : formatSlurmDuration(job.timeLimitSeconds);
+        char gpus[16], priority[32], higher[16];
+        snprintf(gpus, sizeof(gpus), "%d", job.gpuCount);
+        snprintf(priority, sizeof(priority), "%ld", job.priority);
+        if (data.pendingQueueLoaded) snprintf(higher, sizeof(higher), "%d", job.higherCount);
+        else snprintf(higher, sizeof(higher), "...");
+        StringView gpuType = job.gpuCount > 0 ? StringView(job.gpuType.str()) : StringView("N/A");
+        std::string start;
+        if (view == PENDING) {
+            time_t startTime;
+            start = startTimes.lookup(job.jobId, startTime) ? formatStartTime(startTime, time(nullptr)) : "...";
+        }
 
-        int y = 3;
+        // Cell text per column, and whether a cut is marked with "..." (only for
+        // text columns, and not for the focused column)
+        StringView cells[10];
+        bool ellipsize[10] = {false, true, true, false, false, false, true, false, false, false};
+        int numColumns = columnCount(view);
+        cells[0] = job.jobId;
+        cells[1] = job.jobName;
+        cells[2] = ownerOrAccount(job).str();
+        if (view == PENDING) {
+            cells[3] = job.reason.str();
+            ellipsize[3] = true;
+            cells[4] = timeLimit;
+            cells[5] = gpus;
+            cells[6] = gpuType;
+            cells[7] = priority;
+            cells[8] = higher;
+            cells[9] = start;
+        } else {
+            cells[3] = runtime;
+            cells[4] = timeLimit; // End time in the Finished view
+            cells[5] = gpus;
+            cells[6] = gpuType;
+            cells[7] = job.state.str();
+            cells[8] = job.reason.str(); // Finished view: exit code
+        }
 
-        std::vector<Job> pendingJobs;
-        for (const auto& job : data.jobs) {
-            if (job.state == "PENDING") {
-                pendingJobs.push_back(job);
+        // A collapsed array or het job: its first member's row with the group's id,
+        // GPUs, states and priority range
+        GroupCells group;
+        if (const JobGroup* members = collapsedGroup(job, view)) {
+            group = groupCells(job, *members, view);
+            cells[0] = group.jobId;
+            cells[5] = group.gpus;
+            cells[6] = group.gpuType;
+            if (view == PENDING) cells[7] = group.priority;
+            else {
+                cells[7] = group.states;
+                ellipsize[7] = true;
             }
         }
+        if (focusedColumn >= 0 && focusedColumn < numColumns) ellipsize[focusedColumn] = false;
 
-        // Sort by priority
-        std::sort(pendingJobs.begin(), pendingJobs.end(),
-                  [](const Job& a, const Job& b) { return a.priority > b.priority; });
+        std::string line;
+        line.reserve(terminalCols);
+        for (int i = 0; i < numColumns; i++) {
+            if (i > 0) line += ' ';
+            appendCell(line, cells[i], widths[i], ellipsize[i]);
+        }
 
-        attron(COLOR_PAIR(2) | A_BOLD);
-        mvprintw(y++, 2, "PENDING JOBS (%zu jobs)", pendingJobs.size());
-        attroff(COLOR_PAIR(2) | A_BOLD);
-        y++;
+        // HARD truncate to terminal width
+        if ((int)line.size() > terminalCols - 2) line.resize(std::max(0, terminalCols - 2));
+        return line;
+    }
 
-        // Calculate dynamic column widths (9 columns for pending view)
-        int defaultWidths[9] = {10, 16, 16, 15, 10, 5, 10, 10, 8};
-        ColumnWidths w = calculateColumnWidths(cols, 9, defaultWidths, pendingJobs, true);
-
-        // Table header with dynamic widths and focus indicators
-        const char* headers[9] = {"JobID", "JobName", "Account", "Reason", "TimeLimit", "GPUs", "GPU Type", "Priority", "Higher"};
-        int widths[9] = {w.jobId, w.jobName, w.account, w.col4, w.col5, w.col6, w.col7, w.col8, w.col9};
-
-        move(y, 0);
-        clrtoeol();
-        attron(A_BOLD);
-        int xpos = 0;
-        for (int i = 0; i < 9; i++) {
-            move(y, xpos);
-            // Add focus indicator
-            if (focusedColumn == i) {
-                attron(COLOR_PAIR(6)); // Red color for focused
-                // Format: [HeaderName] constrained to column width
-                char headerBuf[64];
-                snprintf(headerBuf, sizeof(headerBuf), "[%s]", headers[i]);
-                printw("%-*.*s", widths[i], widths[i], headerBuf);
-                attroff(COLOR_PAIR(6));
-            } else {
-                // Format: HeaderName constrained to column width
-                printw("%-*.*s", widths[i], widths[i], headers[i]);
+    // Format table row i and write it to screen line y of the table window
+    void drawTableRow(ViewCache& cache, View view, int y, size_t i, int colorPair) {
+        wmove(tableWin, y, 0);
+        wclrtoeol(tableWin);
+        if (i >= cache.rows.size()) return;
+
+        static const InternedString completed("COMPLETED");
+        const Job& job = jobsOf(view)[cache.rows[i]];
+        std::string line = formatRow(view, job, cache.widths, screenCols);
+        if (view == FINISHED && job.state != completed) colorPair = 6; // Failed, timed out, cancelled
+        int attributes = COLOR_PAIR(colorPair) | (i == (size_t)cursor ? A_REVERSE : 0);
+        wattron(tableWin, attributes);
+        waddstr(tableWin, line.c_str());
+        wattroff(tableWin, attributes);
+    }
+
+    // Draw a table view. Title and column headers are redrawn only on new data or a
+    // layout change; scrolling moves the existing rows with wscrl() and formats only
+    // the rows that come into view.
+    void drawJobTable(View view, const char* title, int colorPair) {
+        ViewCache& cache = viewCache(view);
+        const std::vector<size_t>& jobRows = cache.rows;
+        int numColumns = columnCount(view);
+        int cols = screenCols;
+        clampCursor(); // The view may have shrunk
+
+        // Calculate dynamic column widths
+        const ColumnWidths& w = columnLayout(cache, cols, numColumns);
+
+        bool fullRedraw = drawnView != view || drawnGeneration != dataGeneration || drawnFocus != focusedColumn ||
+                          drawnRowsVersion != cache.rowsVersion || (view == PENDING && drawnStartVersion != startVersion);
+        if (fullRedraw) {
+            werase(titleWin);
+            wattron(titleWin, COLOR_PAIR(2) | A_BOLD);
+            if (view == FINISHED && !finished.isLoaded()) mvwprintw(titleWin, 1, 2, "%s (loading sacct...)", title);
+            else if (filterText.empty()) mvwprintw(titleWin, 1, 2, "%s (%zu jobs)", title, jobRows.size());
+            else mvwprintw(titleWin, 1, 2, "%s (%zu of %zu jobs)", title, jobRows.size(), cache.viewRows.size());
+            wattroff(titleWin, COLOR_PAIR(2) | A_BOLD);
+
+            // Table header with dynamic widths and focus indicators
+            const char* runningHeaders[8] = {"JobID", "JobName", "Account", "Runtime", "TimeLimit", "GPUs", "GPU Type", "Status"};
+            const char* pendingHeaders[10] = {"JobID", "JobName", "Account", "Reason", "TimeLimit", "GPUs", "GPU Type", "Priority", "Higher", "Start"};
+            const char* finishedHeaders[9] = {"JobID", "JobName", "Account", "Elapsed", "End", "GPUs", "GPU Type", "State", "Exit"};
+            const char** headers = view == PENDING ? pendingHeaders : (view == FINISHED ? finishedHeaders : runningHeaders);
+            if (showOwners()) headers[2] = "User";
+            int widths[10] = {w.jobId, w.jobName, w.account, w.col4, w.col5, w.col6, w.col7, w.col8, w.col9, w.col10};
+
+            wattron(titleWin, A_BOLD);
+            int xpos = 0;
+            for (int i = 0; i < numColumns; i++) {
+                wmove(titleWin, 3, xpos);
+                // Sort indicator: ^ ascending, v descending
+                const char* sortMark = cache.sortOrder.column != i ? "" : (cache.sortOrder.descending ? "v" : "^");
+                // Add focus indicator
+                if (focusedColumn == i) {
+                    wattron(titleWin, COLOR_PAIR(6)); // Red color for focused
+                    // Format: [HeaderName] constrained to column width
+                    char headerBuf[64];
+                    snprintf(headerBuf, sizeof(headerBuf), "[%s%s]", headers[i], sortMark);
+                    wprintw(titleWin, "%-*.*s", widths[i], widths[i], headerBuf);
+                    wattroff(titleWin, COLOR_PAIR(6));
+                } else {
+                    // Format: HeaderName constrained to column width
+                    char headerBuf[64];
+                    snprintf(headerBuf, sizeof(headerBuf), "%s%s", headers[i], sortMark);
+                    wprintw(titleWin, "%-*.*s", widths[i], widths[i], headerBuf);
+                }
+                xpos += widths[i] + 1; // +1 for space separator
             }
-            xpos += widths[i] + 1; // +1 for space separator
+            wattroff(titleWin, A_BOLD);
+            wnoutrefresh(titleWin);
         }
-        attroff(A_BOLD);
-        y++;
-
-        // Build format string for data rows
-        char fmt[256];
-        snprintf(fmt, sizeof(fmt), "%%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds %%-%d.%ds",
-                 w.jobId, w.jobId, w.jobName, w.jobName, w.account, w.account, w.col4, w.col4,
-                 w.col5, w.col5, w.col6, w.col6, w.col7, w.col7, w.col8, w.col8, w.col9, w.col9);
 
         // Table rows
-        int displayedRows = 0;
-        for (size_t i = scrollOffset; i < pendingJobs.size() && displayedRows < maxRows; i++, displayedRows++) {
-            const Job& job = pendingJobs[i];
-
-            // Count jobs with higher priority in the overall queue
-            int higherPriorityCount = 0;
-            for (const auto& otherJob : data.allPendingJobs) {
-                if (otherJob.priority > job.priority) {
-                    higherPriorityCount++;
+        int shift = scrollOffset - drawnOffset;
+        if (fullRedraw || std::abs(shift) >= maxRows) {
+            for (int y = 0; y < maxRows; y++) drawTableRow(cache, view, y, scrollOffset + y, colorPair);
+            wnoutrefresh(tableWin);
+        } else {
+            if (shift != 0) {
+                wscrl(tableWin, shift);
+                int first = shift > 0 ? maxRows - shift : 0;
+                int last = shift > 0 ? maxRows : -shift;
+                for (int y = first; y < last; y++) drawTableRow(cache, view, y, scrollOffset + y, colorPair);
+            }
+            // The cursor moved: unmark its old row and mark the new one
+            if (drawnCursor != cursor) {
+                int moved[] = {drawnCursor, cursor};
+                for (int row : moved) {
+                    if (row >= scrollOffset && row < scrollOffset + maxRows) {
+                        drawTableRow(cache, view, row - scrollOffset, row, colorPair);
+                    }
                 }
             }
+            if (shift != 0 || drawnCursor != cursor) wnoutrefresh(tableWin);
+        }
+        drawnCursor = cursor;
+
+        // Filter and scroll indicator
+        std::string footer;
+        if (editingFilter) footer = "Filter: " + filterText + "_  (Enter: keep, Esc: clear)  ";
+        else if (!filterText.empty()) footer = "Filter: " + filterText + "  ";
+        if ((int)jobRows.size() > maxRows) {
+            char scroll[128];
+            snprintf(scroll, sizeof(scroll), "Showing %d-%d of %zu (Scroll: %d%%)",
+                     scrollOffset + 1,
+                     std::min(scrollOffset + maxRows, (int)jobRows.size()),
+                     jobRows.size(),
+                     (int)((scrollOffset * 100) / std::max(1, (int)jobRows.size() - maxRows)));
+            footer += scroll;
+        }
+        if (fullRedraw || drawnFooter != footer) {
+            drawnFooter = footer;
+            werase(footerWin);
+            mvwaddnstr(footerWin, 0, 2, footer.c_str(), std::max(0, screenCols - 2));
+            wnoutrefresh(footerWin);
+        }
 
-            // Prepare data fields (use full strings for focused column)
-            std::string jobId = (focusedColumn == 0) ? job.jobId :
-                               (job.jobId.length() > (size_t)w.jobId ? job.jobId.substr(0, w.jobId) : job.jobId);
-            std::string jobName = (focusedColumn == 1) ? job.jobName :
-                                 (job.jobName.length() > (size_t)w.jobName ? job.jobName.substr(0, w.jobName - 3) + "..." : job.jobName);
-            std::string account = (focusedColumn == 2) ? job.account :
-                                 (job.account.length() > (size_t)w.account ? job.account.substr(0, w.account - 3) + "..." : job.account);
-            std::string reason = (focusedColumn == 3) ? job.reason :
-                                (job.reason.length() > (size_t)w.col4 ? job.reason.substr(0, w.col4 - 3) + "..." : job.reason);
-            std::string timeLimit = (focusedColumn == 4) ? job.timeLimit :
-                                   (job.timeLimit.length() > (size_t)w.col5 ? job.timeLimit.substr(0, w.col5) : job.timeLimit);
-            std::string gpuType = (focusedColumn == 6) ? job.gpuType :
-                                 (job.gpuType.length() > (size_t)w.col7 ? job.gpuType.substr(0, w.col7 - 3) + "..." : job.gpuType);
-
-            // Format and truncate numeric fields to prevent overflow
-            char priorityStr[32], higherStr[32];
-            snprintf(priorityStr, sizeof(priorityStr), "%ld", job.priority);
-            snprintf(higherStr, sizeof(higherStr), "%d", higherPriorityCount);
-
-            // Format entire line into buffer first with dynamic widths
-            char fullLine[512];
-            snprintf(fullLine, sizeof(fullLine), fmt,
-                   jobId.c_str(),
-                   jobName.c_str(),
-                   account.c_str(),
-                   reason.c_str(),
-                   timeLimit.c_str(),
-                   std::to_string(job.gpuCount).c_str(),
-                   job.gpuCount > 0 ? gpuType.c_str() : "N/A",
-                   priorityStr,
-                   higherStr);
-
-            // HARD truncate to terminal width
-            if ((int)strlen(fullLine) > cols - 2) {
-                fullLine[cols - 2] = '\0';
-            }
-
-            move(y, 0);
-            clrtoeol();
-            attron(COLOR_PAIR(4));
-            addstr(fullLine);
-
-            attroff(COLOR_PAIR(4));
-            y++;
+        drawnOffset = scrollOffset;
+        drawnRowsVersion = cache.rowsVersion;
+        drawnStartVersion = startVersion;
+
+        // Estimates are only asked for the pending jobs on screen
+        if (view == PENDING) {
+            std::vector<std::string> visible;
+            size_t end = std::min(jobRows.size(), (size_t)(scrollOffset + maxRows));
+            for (size_t i = scrollOffset; i < end; i++) visible.push_back(data.jobs[jobRows[i]].jobId);
+            startTimes.request(visible);
         }
+    }
 
-        // Scroll indicator
-        if (pendingJobs.size() > maxRows) {
-            mvprintw(rows - 1, 2, "Showing %d-%zu of %zu (Scroll: %d%%)",
-                     scrollOffset + 1,
-                     std::min(scrollOffset + maxRows, (int)pendingJobs.size()),
-                     pendingJobs.size(),
-                     (int)((scrollOffset * 100) / std::max(1, (int)pendingJobs.size() - maxRows)));
+    // Lines of the detail pane
+    static std::vector<std::string> detailLines(const JobDetails& details) {
+        auto shown = [](const std::string& value) { return value.empty() ? std::string("-") : value; };
+        std::string reason = details.reason.empty() || details.reason == "None" ? "" : " (" + details.reason + ")";
+        std::vector<std::string> lines;
+        lines.push_back("State:      " + shown(details.state) + reason + "   Partition: " + shown(details.partition) +
+                        "   QOS: " + shown(details.qos));
+        lines.push_back("Nodes:      " + shown(details.nodeList) + "   (" + shown(details.numNodes) + " nodes, " +
+                        shown(details.numCpus) + " CPUs)");
+        lines.push_back("Submitted:  " + shown(details.submitTime) + "   Started: " + shown(details.startTime) +
+                        "   Ends: " + shown(details.endTime));
+        lines.push_back("WorkDir:    " + shown(details.workDir));
+        lines.push_back("Command:    " + shown(details.command));
+        lines.push_back("Output:     " + shown(details.stdOut));
+        lines.push_back("Requested:  " + shown(details.reqTres));
+        lines.push_back("Allocated:  " + shown(details.allocTres));
+        lines.push_back("Dependency: " + shown(details.dependency));
+        return lines;
+    }
+
+    // Detail pane: scontrol details of the job under the cursor. Moving the cursor
+    // asks for that job and prefetches its kDetailPrefetch neighbours on each side.
+    void drawDetail() {
+        const std::vector<size_t>& rows = viewCache(currentView).rows;
+        const std::vector<Job>& jobs = jobsOf(currentView);
+        std::string jobId = cursor < (int)rows.size() ? jobs[rows[cursor]].jobId : std::string();
+        bool moved = jobId != drawnDetailJob || drawnView != currentView;
+        if (!moved && drawnDetailVersion == detailVersion) return;
+        if (moved) {
+            std::vector<std::string> prefetch;
+            for (int distance = 1; distance <= kDetailPrefetch; distance++) {
+                if (cursor + distance < (int)rows.size()) prefetch.push_back(jobs[rows[cursor + distance]].jobId);
+                if (cursor - distance >= 0) prefetch.push_back(jobs[rows[cursor - distance]].jobId);
+            }
+            jobDetails.request(jobId, prefetch);
+        }
+        drawnDetailJob = jobId;
+        drawnDetailVersion = detailVersion;
+
+        werase(detailWin);
+        wattron(detailWin, COLOR_PAIR(2) | A_BOLD);
+        mvwhline(detailWin, 0, 0, ACS_HLINE, screenCols);
+        mvwprintw(detailWin, 0, 2, " JOB %s  (Enter: close) ", jobId.c_str());
+        wattroff(detailWin, COLOR_PAIR(2) | A_BOLD);
+
+        JobDetails details;
+        if (jobId.empty()) {
+            mvwaddstr(detailWin, 1, 4, "No job selected");
+        } else if (!jobDetails.lookup(jobId, details)) {
+            mvwprintw(detailWin, 1, 4, "Loading scontrol show job %s...", jobId.c_str());
+        } else {
+            std::vector<std::string> lines = detailLines(details);
+            for (size_t i = 0; i < lines.size() && (int)i + 1 < kDetailRows; i++) {
+                mvwaddnstr(detailWin, i + 1, 4, lines[i].c_str(), std::max(0, screenCols - 6));
+            }
         }
+        wnoutrefresh(detailWin);
+    }
+
+    // Timings line; shows the previous draws, as this one is still being measured
+    void drawStats() {
+        if (!statsWin) return;
+        std::string line = perf.summary();
+        if (line == drawnStats) return;
+        drawnStats = line;
+        werase(statsWin);
+        wattron(statsWin, COLOR_PAIR(2));
+        mvwaddnstr(statsWin, 0, 2, line.c_str(), std::max(0, screenCols - 2));
+        wattroff(statsWin, COLOR_PAIR(2));
+        wnoutrefresh(statsWin);
     }
 
     void draw() {
-        erase();  // Clear the entire screen
+        double seconds = 0;
+        {
+            ScopeTimer timer(seconds);
+            drawScreen();
+        }
+        perf.addDraw(seconds);
+    }
+
+    void drawScreen() {
+        int rows, cols;
+        getmaxyx(stdscr, rows, cols);
+        if (rows != screenRows || cols != screenCols || !tableWin || showStats != (statsWin != nullptr) ||
+            showDetailPane() != (detailWin != nullptr)) {
+            createWindows(rows, cols);
+        }
+
         drawHeader();
 
         switch (currentView) {
             case OVERVIEW:
                 drawOverview();
                 break;
-            case RUNNING: {
-                std::vector<Job> runningJobs;
-                for (const auto& job : data.jobs) {
-                    if (job.state == "RUNNING") {
-                        runningJobs.push_back(job);
-                    }
-                }
-                drawJobTable(runningJobs, "RUNNING JOBS", 3);
+            case RUNNING:
+                drawJobTable(RUNNING, "RUNNING JOBS", 3);
                 break;
-            }
             case PENDING:
-                drawPendingView();
+                drawJobTable(PENDING, "PENDING JOBS", 4);
                 break;
             case ALL:
-                drawJobTable(data.jobs, "ALL JOBS", 5);
+                drawJobTable(ALL, "ALL JOBS", 5);
                 break;
+            case FINISHED:
+                drawJobTable(FINISHED, "FINISHED JOBS - LAST 24H", 3);
+                break;
+        }
+        if (detailWin) {
+            drawDetail();
+        } else if (!drawnDetailJob.empty()) {
+            jobDetails.request(std::string(), std::vector<std::string>()); // Stop refreshing it
+            drawnDetailJob.clear();
         }
+        if (currentView != PENDING) startTimes.request(std::vector<std::string>()); // No estimates off screen
+        drawnView = currentView;
+        drawnGeneration = dataGeneration;
+        drawnFocus = focusedColumn;
+        drawStats();
 
-        refresh();
+        doupdate(); // Send only what changed to the terminal
     }
 
-    bool handleInput() {
-        int ch = getch();
+    // A new snapshot was swapped into data: cached views and column widths are stale
+    void dataChanged() {
+        dataGeneration++;
+        if (!perf.addRefresh(data.stats)) return; // Partial or cached: not a sample of its own
+        if (statsLog) perf.log(statsLog);
+        startTimes.retain(data.jobs);
+        history.add(usageSample(data, time(nullptr)));
+        if (finished.started()) finished.refresh(data.selection); // The Finished view follows the refreshes
+    }
+
+    // Fill the history with the hours before this session (sacct, in the background)
+    void seedHistory(const JobSelection& selection, int hours) {
+        historySeed.start(selection, hours);
+    }
+
+    // Write a line per refresh to out (see PerformanceStats::log)
+    void setStatsLog(FILE* out) {
+        statsLog = out;
+    }
+
+    // Apply a key to the filter being typed; false for keys that keep their usual
+    // meaning (scrolling, focus, ...)
+    bool editFilter(int ch) {
+        if (ch == '\n' || ch == '\r' || ch == KEY_ENTER) {
+            editingFilter = false;
+        } else if (ch == 27) { // Esc
+            editingFilter = false;
+            filterText.clear();
+        } else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8) {
+            if (!filterText.empty()) filterText.erase(filterText.size() - 1);
+        } else if (ch >= 32 && ch < 127) {
+            filterText += static_cast<char>(tolower(ch));
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Largest scroll offset of the current view that still fills the table window
+    int maxScrollOffset() {
+        if (currentView == OVERVIEW) return 0;
+        return std::max(0, (int)viewCache(currentView).rows.size() - maxRows);
+    }
 
-        if (ch == ERR) return false; // No input
+    // Keep the cursor on a row of the current view, and the window around the cursor
+    void clampCursor() {
+        int lastRow = currentView == OVERVIEW ? 0 : std::max(0, (int)viewCache(currentView).rows.size() - 1);
+        cursor = std::max(0, std::min(cursor, lastRow));
+        if (cursor < scrollOffset) scrollOffset = cursor;
+        if (cursor >= scrollOffset + maxRows) scrollOffset = cursor - maxRows + 1;
+        scrollOffset = std::max(0, std::min(scrollOffset, maxScrollOffset()));
+    }
 
+    // Apply one key press; returns whether the screen needs a redraw
+    bool handleKey(int ch) {
+        View oldView = currentView;
         bool needRedraw = true;
+        bool scrolled = false; // A scroll key, which only needs a redraw if the offset moved
+        int oldOffset = scrollOffset;
+
+        if (editingFilter && editFilter(ch)) {
+            scrollOffset = cursor = 0;
+            return true;
+        }
 
         switch (ch) {
             case 'q':
@@ -900,40 +5084,104 @@ public:
                 break;
             case 'r':
             case 'R':
-                fetchSlurmData(data);
-                scrollOffset = 0;
+                fetcher.requestRefresh();
+                if (finished.started()) finished.refresh(data.selection);
+                scrollOffset = cursor = 0;
+                break;
+            case 't':
+            case 'T':
+                showStats = !showStats; // draw() recreates the windows
+                break;
+            case 'h':
+            case 'H':
+                // Next history resolution (1 s, 1 min, 10 min per column)
+                if (currentView == OVERVIEW) {
+                    historyTier = (historyTier + 1) % kHistoryTierCount;
+                    drawnView = -1;
+                } else {
+                    needRedraw = false;
+                }
+                break;
+            case 'g':
+            case 'G':
+                groupJobs = !groupJobs;
+                dataGeneration++; // Rebuild the rows of every view
+                scrollOffset = cursor = 0;
+                break;
+            case 's':
+            case 'S':
+                // Sort by the focused column, reversing on a second press; without a
+                // focused column, back to the view's default order
+                if (currentView != OVERVIEW) {
+                    SortOrder& order = sortOrders[currentView];
+                    if (focusedColumn < 0) order = SortOrder();
+                    else if (order.column == focusedColumn) order.descending = !order.descending;
+                    else {
+                        order.column = focusedColumn;
+                        order.descending = false;
+                    }
+                    scrollOffset = cursor = 0;
+                }
+                break;
+            case '/':
+                if (currentView != OVERVIEW) editingFilter = true;
+                break;
+            case 27: // Esc
+                if (showDetail) {
+                    showDetail = false; // Close the detail pane first
+                    break;
+                }
+                if (filterText.empty()) needRedraw = false;
+                filterText.clear();
+                scrollOffset = cursor = 0;
                 break;
             case '1':
                 currentView = OVERVIEW;
-                scrollOffset = 0;
+                scrollOffset = cursor = 0;
                 focusedColumn = -1;
                 break;
             case '2':
                 currentView = RUNNING;
-                scrollOffset = 0;
+                scrollOffset = cursor = 0;
                 focusedColumn = -1;
                 break;
             case '3':
                 currentView = PENDING;
-                scrollOffset = 0;
+                scrollOffset = cursor = 0;
                 focusedColumn = -1;
                 break;
             case '4':
                 currentView = ALL;
-                scrollOffset = 0;
+                scrollOffset = cursor = 0;
+                focusedColumn = -1;
+                break;
+            case '5':
+                currentView = FINISHED;
+                scrollOffset = cursor = 0;
                 focusedColumn = -1;
+                if (!finished.started()) finished.refresh(data.selection); // First use: the whole window
                 break;
             case KEY_UP:
-                if (scrollOffset > 0) scrollOffset--;
+                cursor--;
+                scrolled = true;
                 break;
             case KEY_DOWN:
-                scrollOffset++;
+                cursor++;
+                scrolled = true;
+                break;
+            case KEY_HOME:
+                scrollOffset = cursor = 0;
+                scrolled = true;
+                break;
+            case KEY_END:
+                cursor = INT_MAX; // Clamped to the last row below
+                scrolled = true;
                 break;
             case KEY_LEFT:
                 // Cycle focus left through columns (-1 means no focus)
                 if (currentView != OVERVIEW) {
                     focusedColumn--;
-                    int maxCol = (currentView == PENDING) ? 8 : 7;  // Pending has 9 columns (0-8), others have 8 (0-7)
+                    int maxCol = columnCount(currentView) - 1;
                     if (focusedColumn < -1) focusedColumn = maxCol;
                 }
                 break;
@@ -941,15 +5189,24 @@ public:
                 // Cycle focus right through columns
                 if (currentView != OVERVIEW) {
                     focusedColumn++;
-                    int maxCol = (currentView == PENDING) ? 8 : 7;  // Pending has 9 columns (0-8), others have 8 (0-7)
+                    int maxCol = columnCount(currentView) - 1;
                     if (focusedColumn > maxCol) focusedColumn = -1;
                 }
                 break;
             case KEY_PPAGE: // Page Up
-                scrollOffset = std::max(0, scrollOffset - maxRows);
+                scrollOffset -= maxRows;
+                cursor -= maxRows;
+                scrolled = true;
                 break;
             case KEY_NPAGE: // Page Down
                 scrollOffset += maxRows;
+                cursor += maxRows;
+                scrolled = true;
+                break;
+            case '\n':
+            case '\r':
+            case KEY_ENTER:
+                if (currentView != OVERVIEW) showDetail = !showDetail; // draw() recreates the windows
                 break;
             case KEY_RESIZE:
                 // Terminal was resized
@@ -959,44 +5216,725 @@ public:
                 break;
         }
 
-        // Limit scroll offset
-        if (scrollOffset < 0) scrollOffset = 0;
+        fetcher.setCapacityWanted(currentView == OVERVIEW);
+        if (currentView == OVERVIEW && oldView != OVERVIEW) fetcher.requestCapacity();
+
+        // Keep the window within the view (no scrolling past the last row) and
+        // around the cursor
+        int oldCursor = cursor;
+        clampCursor();
+        if (scrolled) needRedraw = scrollOffset != oldOffset || cursor != oldCursor;
 
         return needRedraw;
     }
 
+    // Milliseconds until the status text changes by itself (the age of the data
+    // ticks over), or -1 if it only changes on fetcher events
+    int statusTimeout() {
+        std::string failure;
+        double retrySeconds;
+        bool failing = fetcher.lastFailure(failure, retrySeconds);
+        if (failing && !fetcher.isFetching()) return 1000; // The retry countdown
+        // Stale data (from the snapshot file, or kept after failed refreshes) shows its
+        // age also while a refresh runs, which can take until the command timeout
+        if (!data.loaded || !data.complete || (fetcher.isFetching() && !data.stale && !failing)) return -1;
+        long age = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - data.updatedAt).count();
+        long unit = age < 60000 ? 1000 : (age < 3600000 ? 60000 : 3600000); // Units of formatAge()
+        return (int)(unit - age % unit) + 1;
+    }
+
+    // Sleep until there is input, a resize, news from the fetcher or the status
+    // text is due to change. The auto-refresh timer runs in the fetcher thread,
+    // which reports the start of every fetch.
+    void waitForEvents() {
+        struct pollfd fds[7];
+        int count = 0;
+        fds[count].fd = STDIN_FILENO;
+        fds[count++].events = POLLIN;
+        fds[count].fd = fetcher.notifyFd();
+        fds[count++].events = POLLIN;
+        fds[count].fd = startTimes.notifyFd();
+        fds[count++].events = POLLIN;
+        fds[count].fd = jobDetails.notifyFd();
+        fds[count++].events = POLLIN;
+        fds[count].fd = historySeed.notifyFd();
+        fds[count++].events = POLLIN;
+        fds[count].fd = finished.notifyFd();
+        fds[count++].events = POLLIN;
+        if (resizePipe[0] >= 0) {
+            fds[count].fd = resizePipe[0];
+            fds[count++].events = POLLIN;
+        }
+
+        if (poll(fds, count, statusTimeout()) <= 0) return;
+        if (resizePipe[0] >= 0 && fds[count - 1].revents) {
+            char buffer[64];
+            while (read(resizePipe[0], buffer, sizeof(buffer)) > 0) {}
+        }
+        if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) running = false; // Terminal went away
+    }
+
     void run() {
         draw(); // Initial draw
         while (running) {
-            if (handleInput()) {
-                draw(); // Only redraw if input was handled
+            waitForEvents();
+            if (hangupReceived) break;
+            fetcher.clearNotifications();
+
+            // Drain all pending keys (and KEY_RESIZE after a SIGWINCH) before drawing
+            bool needRedraw = false;
+            int ch;
+            while (running && (ch = getch()) != ERR) {
+                if (handleKey(ch)) needRedraw = true;
+            }
+            if (fetcher.takeUpdate(data)) {
+                dataChanged();
+                needRedraw = true; // New snapshot from the fetcher thread
+            }
+            if (startTimes.takeNotifications()) {
+                startVersion++;
+                if (currentView == PENDING) needRedraw = true; // New start estimates
+            }
+            if (jobDetails.takeNotifications()) {
+                detailVersion++;
+                if (detailWin) needRedraw = true;
+            }
+            if (finished.takeNotifications() && finished.takeUpdate(finishedJobs)) {
+                dataGeneration++; // Rebuild the rows, which index into finishedJobs
+                if (currentView == FINISHED) needRedraw = true;
+            }
+            std::vector<UsageSample> seeded;
+            if (historySeed.take(seeded)) {
+                for (const auto& sample : seeded) history.add(sample);
+                drawnView = -1; // Only the overview shows the history
+                if (currentView == OVERVIEW) needRedraw = true;
+            }
+            if (statusText() != drawnStatus) {
+                needRedraw = true; // Keep the refresh indicator current
+            }
+            if (needRedraw && running) {
+                draw(); // Only redraw if something changed
+            }
+        }
+    }
+};
+
+// Text assembled in a buffer and written to a file descriptor in large blocks,
+// without iostream formatting or per-call locking
+class OutputBuffer {
+private:
+    int fd;
+    std::string buffer;
+    bool failed;
+
+public:
+    static const size_t kFlushSize = 64 * 1024;
+
+    explicit OutputBuffer(int out) : fd(out), failed(false) {
+        buffer.reserve(kFlushSize * 2);
+    }
+
+    ~OutputBuffer() {
+        flush();
+    }
+
+    OutputBuffer& operator<<(StringView text) {
+        buffer.append(text.data(), text.size());
+        if (buffer.size() >= kFlushSize) flush();
+        return *this;
+    }
+
+    OutputBuffer& operator<<(char c) {
+        buffer += c;
+        return *this;
+    }
+
+    OutputBuffer& operator<<(long n) {
+        char digits[24];
+        char* p = digits + sizeof(digits);
+        unsigned long value = n < 0 ? 0UL - (unsigned long)n : (unsigned long)n;
+        do {
+            *--p = '0' + value % 10;
+            value /= 10;
+        } while (value > 0);
+        if (n < 0) *--p = '-';
+        return *this << StringView(p, digits + sizeof(digits) - p);
+    }
+
+    OutputBuffer& operator<<(int n) { return *this << (long)n; }
+    OutputBuffer& operator<<(size_t n) { return *this << (long)n; }
+
+    // JSON string literal, quotes included
+    void jsonString(StringView text) {
+        buffer += '"';
+        for (size_t i = 0; i < text.size(); i++) {
+            unsigned char c = text[i];
+            if (c == '"' || c == '\\') {
+                buffer += '\\';
+                buffer += c;
+            } else if (c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                buffer += escaped;
+            } else {
+                buffer += c;
             }
         }
+        buffer += '"';
+    }
+
+    // CSV field, quoted only when it contains a separator, quote or line break
+    void csvField(StringView text) {
+        if (text.find(',') == std::string::npos && text.find('"') == std::string::npos &&
+            text.find('\n') == std::string::npos && text.find('\r') == std::string::npos) {
+            *this << text;
+            return;
+        }
+        buffer += '"';
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '"') buffer += '"';
+            buffer += text[i];
+        }
+        buffer += '"';
+    }
+
+    // Prometheus label value, quotes included
+    void labelValue(StringView text) {
+        buffer += '"';
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '"' || text[i] == '\\') buffer += '\\';
+            if (text[i] == '\n') buffer += "\\n";
+            else buffer += text[i];
+        }
+        buffer += '"';
     }
+
+    // Write out everything buffered; false once a write has failed (e.g. closed pipe)
+    bool flush() {
+        size_t done = 0;
+        while (!failed && done < buffer.size()) {
+            ssize_t n = write(fd, buffer.data() + done, buffer.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) failed = true;
+            else done += n;
+        }
+        buffer.clear();
+        return !failed;
+    }
+};
+
+// Formats of --batch output
+enum class BatchFormat {
+    JSON,
+    CSV,
+    PROMETHEUS
 };
 
+bool parseBatchFormat(const std::string& name, BatchFormat& format) {
+    if (name == "json") format = BatchFormat::JSON;
+    else if (name == "csv") format = BatchFormat::CSV;
+    else if (name == "prometheus") format = BatchFormat::PROMETHEUS;
+    else return false;
+    return true;
+}
+
+// Position of a pending job in the global queue (1 = next to start), 0 if unknown
+long queuePosition(const SlurmData& data, const Job& job) {
+    if (!data.pendingQueueLoaded || job.getState() != JobState::PENDING) return 0;
+    return job.higherCount + 1;
+}
+
+// One JSON object per snapshot, on a single line so that streaming output is
+// newline-delimited JSON. Durations are seconds; null where squeue had none
+// (UNLIMITED, NOT_SET) and for queue positions of jobs that are not pending.
+void writeJson(OutputBuffer& out, const SlurmData& data, time_t fetchedAt) {
+    auto writeCounts = [&out](const std::map<std::string, int>& counts) {
+        out << '{';
+        bool first = true;
+        for (const auto& entry : counts) {
+            if (!first) out << ',';
+            first = false;
+            out.jsonString(entry.first);
+            out << ':' << entry.second;
+        }
+        out << '}';
+    };
+    auto writeDuration = [&out](long seconds) {
+        if (seconds >= 0) out << seconds;
+        else out << "null";
+    };
+    auto writeNames = [&out](const std::vector<std::string>& names) {
+        out << '[';
+        for (size_t i = 0; i < names.size(); i++) {
+            if (i > 0) out << ',';
+            out.jsonString(names[i]);
+        }
+        out << ']';
+    };
+    auto writeGroups = [&](const std::map<std::string, GroupUsage>& groups) {
+        out << '{';
+        bool first = true;
+        for (const auto& group : groups) {
+            if (!first) out << ',';
+            first = false;
+            const GroupUsage& usage = group.second;
+            out.jsonString(group.first);
+            out << ":{\"jobs\":" << usage.jobs << ",\"running_jobs\":" << usage.runningJobs
+                << ",\"pending_jobs\":" << usage.pendingJobs << ",\"cpus_running\":" << usage.runningTres.cpus
+                << ",\"gpus_running\":";
+            writeCounts(usage.gpuTypeCount);
+            out << ",\"gpus_requested\":";
+            writeCounts(usage.gpuTypeRequested);
+            out << '}';
+        }
+        out << '}';
+    };
+
+    out << "{\"users\":";
+    writeNames(data.selection.users);
+    out << ",\"accounts\":";
+    writeNames(data.selection.accounts);
+    out << ",\"fetched_at\":" << (long)fetchedAt << ",\"total_jobs\":" << data.totalJobs
+        << ",\"running_jobs\":" << data.runningJobs << ",\"pending_jobs\":" << data.pendingJobs
+        << ",\"queue_length\":" << data.allPendingJobs.size() << ",\"gpus_running\":";
+    writeCounts(data.gpuTypeCount);
+    out << ",\"gpus_requested\":";
+    writeCounts(data.gpuTypeRequested);
+    out << ",\"by_user\":";
+    writeGroups(data.userUsage);
+    out << ",\"by_account\":";
+    writeGroups(data.accountUsage);
+    out << ",\"jobs\":[";
+    for (size_t i = 0; i < data.jobs.size(); i++) {
+        const Job& job = data.jobs[i];
+        if (i > 0) out << ',';
+        out << "{\"job_id\":";
+        out.jsonString(job.jobId);
+        out << ",\"name\":";
+        out.jsonString(job.jobName);
+        out << ",\"user\":";
+        out.jsonString(job.user.str());
+        out << ",\"account\":";
+        out.jsonString(job.account.str());
+        out << ",\"state\":";
+        out.jsonString(job.state.str());
+        out << ",\"reason\":";
+        out.jsonString(job.reason.str());
+        out << ",\"runtime_seconds\":";
+        writeDuration(job.runtimeSeconds);
+        out << ",\"time_limit_seconds\":";
+        writeDuration(job.timeLimitSeconds);
+        out << ",\"priority\":" << job.priority << ",\"cpus\":" << job.tres.cpus
+            << ",\"memory_mb\":" << job.tres.memoryMB << ",\"nodes\":" << job.tres.nodes
+            << ",\"gpus\":" << job.gpuCount << ",\"gpu_type\":";
+        out.jsonString(job.gpuType.str());
+        out << ",\"queue_position\":";
+        long position = queuePosition(data, job);
+        if (position > 0) out << position;
+        else out << "null";
+        out << '}';
+    }
+    out << "]}\n";
+}
+
+// One row per job. The header is written once, before the first snapshot;
+// fetched_at tells the snapshots of streaming output apart. Empty fields stand
+// for missing values.
+void writeCsv(OutputBuffer& out, const SlurmData& data, time_t fetchedAt, bool header) {
+    if (header) {
+        out << "fetched_at,user,job_id,name,account,state,reason,runtime_seconds,time_limit_seconds,"
+               "priority,cpus,memory_mb,nodes,gpus,gpu_type,queue_position\n";
+    }
+    for (const Job& job : data.jobs) {
+        out << (long)fetchedAt << ',';
+        out.csvField(job.user.str());
+        out << ',';
+        out.csvField(job.jobId);
+        out << ',';
+        out.csvField(job.jobName);
+        out << ',';
+        out.csvField(job.account.str());
+        out << ',';
+        out.csvField(job.state.str());
+        out << ',';
+        out.csvField(job.reason.str());
+        out << ',';
+        if (job.runtimeSeconds >= 0) out << job.runtimeSeconds;
+        out << ',';
+        if (job.timeLimitSeconds >= 0) out << job.timeLimitSeconds;
+        out << ',' << job.priority << ',' << job.tres.cpus << ',' << job.tres.memoryMB << ','
+            << job.tres.nodes << ',' << job.gpuCount << ',';
+        out.csvField(job.gpuType.str());
+        out << ',';
+        long position = queuePosition(data, job);
+        if (position > 0) out << position;
+        out << '\n';
+    }
+}
+
+// Prometheus text exposition format, e.g. for node_exporter's textfile collector.
+// Usage is broken down by job owner (label user) and by account (slurmtop_account_*).
+void writePrometheus(OutputBuffer& out, const SlurmData& data) {
+    auto family = [&out](const char* name, const char* help) {
+        out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " gauge\n";
+    };
+    auto sample = [&out](const char* name, const char* groupLabel, StringView group, const char* label,
+                         StringView value, long count) {
+        out << name << '{' << groupLabel << '=';
+        out.labelValue(group);
+        out << ',' << label << '=';
+        out.labelValue(value);
+        out << "} " << count << '\n';
+    };
+    auto groupFamilies = [&](const char* prefix, const char* groupLabel, const std::map<std::string, GroupUsage>& groups) {
+        std::string name = std::string(prefix) + "jobs";
+        family(name.c_str(), "Jobs by state");
+        for (const auto& group : groups) {
+            const GroupUsage& usage = group.second;
+            sample(name.c_str(), groupLabel, group.first, "state", "running", usage.runningJobs);
+            sample(name.c_str(), groupLabel, group.first, "state", "pending", usage.pendingJobs);
+            sample(name.c_str(), groupLabel, group.first, "state", "other", usage.jobs - usage.runningJobs - usage.pendingJobs);
+        }
+
+        name = std::string(prefix) + "gpus_allocated";
+        family(name.c_str(), "GPUs allocated to running jobs by type");
+        for (const auto& group : groups) {
+            for (const auto& entry : group.second.gpuTypeCount) {
+                sample(name.c_str(), groupLabel, group.first, "gpu_type", entry.first, entry.second);
+            }
+        }
+        name = std::string(prefix) + "gpus_requested";
+        family(name.c_str(), "GPUs requested by pending jobs by type");
+        for (const auto& group : groups) {
+            for (const auto& entry : group.second.gpuTypeRequested) {
+                sample(name.c_str(), groupLabel, group.first, "gpu_type", entry.first, entry.second);
+            }
+        }
+
+        name = std::string(prefix) + "cpus";
+        family(name.c_str(), "CPUs of running (allocated) and pending (requested) jobs");
+        for (const auto& group : groups) {
+            sample(name.c_str(), groupLabel, group.first, "state", "running", group.second.runningTres.cpus);
+            sample(name.c_str(), groupLabel, group.first, "state", "pending", group.second.pendingTres.cpus);
+        }
+        name = std::string(prefix) + "memory_bytes";
+        family(name.c_str(), "Memory of running (allocated) and pending (requested) jobs");
+        for (const auto& group : groups) {
+            sample(name.c_str(), groupLabel, group.first, "state", "running", group.second.runningTres.memoryMB * 1048576);
+            sample(name.c_str(), groupLabel, group.first, "state", "pending", group.second.pendingTres.memoryMB * 1048576);
+        }
+    };
+
+    groupFamilies("slurmtop_", "user", data.userUsage);
+    groupFamilies("slurmtop_account_", "account", data.accountUsage);
+
+    if (data.pendingQueueLoaded) {
+        family("slurmtop_queue_position", "Position of each pending job in the global queue (1 = next)");
+        for (const Job& job : data.jobs) {
+            long position = queuePosition(data, job);
+            if (position > 0) sample("slurmtop_queue_position", "user", job.user.str(), "job_id", job.jobId, position);
+        }
+        out << "# HELP slurmtop_queue_length Pending jobs of all users\n# TYPE slurmtop_queue_length gauge\n"
+            << "slurmtop_queue_length " << data.allPendingJobs.size() << '\n';
+    }
+}
+
+// --batch: fetch once (or every interval seconds, adapting like the UI does) and
+// write each snapshot to stdout. Runs on the calling thread without ncurses, the
+// fetcher thread or the snapshot file, so the only startup cost is the fetch itself.
+int runBatch(SlurmData& data, SlurmDataSource& source, BatchFormat format, double interval) {
+    OutputBuffer out(STDOUT_FILENO);
+    double currentInterval = std::max(interval, kMinRefreshInterval);
+    RetryBackoff backoff;
+    for (bool first = true;;) {
+        std::chrono::steady_clock::time_point fetchStart = std::chrono::steady_clock::now();
+        bool fetched = fetchSlurmData(data, source);
+        double fetchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fetchStart).count();
+
+        // A failed refresh prints nothing: a consumer would take the missing jobs for ended ones
+        if (!fetched) {
+            std::cerr << "slurmtop: " << source.lastFailure() << std::endl;
+            if (interval <= 0) return 1;
+            std::this_thread::sleep_for(std::chrono::duration<double>(backoff.failed(currentInterval)));
+            continue;
+        }
+        backoff.succeeded();
+
+        time_t fetchedAt = time(nullptr);
+        switch (format) {
+            case BatchFormat::JSON: writeJson(out, data, fetchedAt); break;
+            case BatchFormat::CSV: writeCsv(out, data, fetchedAt, first); break;
+            case BatchFormat::PROMETHEUS: writePrometheus(out, data); break;
+        }
+        first = false;
+        if (!out.flush()) return 1;
+        if (interval <= 0) return 0;
+
+        if (format == BatchFormat::PROMETHEUS) out << '\n'; // Blank line between expositions
+        currentInterval = nextRefreshInterval(currentInterval, interval, fetchSeconds);
+        std::this_thread::sleep_for(std::chrono::duration<double>(currentInterval)); // From the end of the fetch
+    }
+}
+
+#ifndef SLURMTOP_NO_MAIN
+void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] <username>..." << std::endl;
+    std::cerr << "       " << prog << " [options] -u USER[,USER...] | -A ACCOUNT[,ACCOUNT...]" << std::endl;
+    std::cerr << "       " << prog << " --batch [--format FMT] [-i SEC] [options] <username>..." << std::endl;
+    std::cerr << "       " << prog << " --serve [-i SEC] [--socket PATH]" << std::endl;
+    std::cerr << "\nOptions:" << std::endl;
+    std::cerr << "  -i, --interval SEC  Auto-refresh every SEC seconds (adapts to squeue latency)" << std::endl;
+    std::cerr << "  -u, --user LIST     Show the jobs of these users (comma-separated, repeatable)" << std::endl;
+    std::cerr << "  -A, --account LIST  Show the jobs of these accounts (with -u: jobs matching both)" << std::endl;
+    std::cerr << "  -b, --backend NAME  Data source: auto, squeue or libslurm (default: auto)" << std::endl;
+    std::cerr << "  --batch             Print the jobs to stdout instead of showing them, once or" << std::endl;
+    std::cerr << "                      every SEC seconds with -i" << std::endl;
+    std::cerr << "  --format FMT        --batch output: json, csv or prometheus (default: json)" << std::endl;
+    std::cerr << "  --serve             Run the shared queue cache for all users on this host" << std::endl;
+    std::cerr << "                      (fetches every SEC seconds, default " << kDefaultServeInterval << ")" << std::endl;
+    std::cerr << "  --socket PATH       Queue cache socket (default " << kDefaultQueueSocket << ", empty: none)" << std::endl;
+    std::cerr << "  --socket-owner USER Also trust a queue cache run by USER (besides root and yourself)" << std::endl;
+    std::cerr << "  --stats FILE        Append fetch, parse and draw timings of every refresh to FILE" << std::endl;
+    std::cerr << "  --threads N         Parse the global pending queue with N threads once squeue is done"
+              << std::endl;
+    std::cerr << "                      (default " << kDefaultParseThreads << ": while squeue writes it)" << std::endl;
+    std::cerr << "  --history HOURS     Start the overview's history with the last HOURS hours from sacct" << std::endl;
+    std::cerr << "  -h, --help          Show this help" << std::endl;
+    std::cerr << "\nControls:" << std::endl;
+    std::cerr << "  1-5: Switch views (Overview/Running/Pending/All/Finished)" << std::endl;
+    std::cerr << "  Up/Down: Move the cursor (the table scrolls with it)" << std::endl;
+    std::cerr << "  Enter: Show or hide the details of the job under the cursor (scontrol)" << std::endl;
+    std::cerr << "  Left/Right: Focus column" << std::endl;
+    std::cerr << "  S: Sort by the focused column (again: reverse; no focus: default order)" << std::endl;
+    std::cerr << "  /: Filter by id, name, user, account, GPU type, state or reason (Esc: clear)" << std::endl;
+    std::cerr << "  G: Show each array or het job as one row (again: expand)" << std::endl;
+    std::cerr << "  PgUp/PgDn: Scroll by page" << std::endl;
+    std::cerr << "  Home/End: Jump to the first/last job" << std::endl;
+    std::cerr << "  R: Refresh" << std::endl;
+    std::cerr << "  H: History resolution in the overview (1s, 1m or 10m per column)" << std::endl;
+    std::cerr << "  T: Show timings (fetch/parse/sort/draw, min/avg/p99)" << std::endl;
+    std::cerr << "  Q: Quit" << std::endl;
+}
+
+// Add the comma-separated names of list to names. Names go into the squeue
+// command line, so only characters that user and account names use are allowed.
+bool addNames(const std::string& list, std::vector<std::string>& names) {
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        std::string name = list.substr(start, comma - start);
+        if (name.empty()) return false;
+        for (char c : name) {
+            if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-' && c != '.' && c != '@') return false;
+        }
+        if (std::find(names.begin(), names.end(), name) == names.end()) names.push_back(name);
+        start = comma + 1;
+    }
+    return true;
+}
+
+// Set by SIGINT/SIGTERM to stop --serve
+volatile sig_atomic_t serverStopRequested = 0;
+
+void onServerStop(int) {
+    serverStopRequested = 1;
+}
+
+int runServer(const std::string& socketPath, double interval, int threads) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onServerStop; // No SA_RESTART, so poll() returns at once
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    QueueServer server(socketPath, interval, threads);
+    std::string error;
+    if (!server.start(error)) {
+        std::cerr << "Cannot serve on " << socketPath << ": " << error << std::endl;
+        return 1;
+    }
+    std::cerr << "Serving the pending queue on " << socketPath << ", refreshed every "
+              << std::max(interval, kMinRefreshInterval) << "s or slower" << std::endl;
+    server.run(serverStopRequested);
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <username>" << std::endl;
-        std::cerr << "\nControls:" << std::endl;
-        std::cerr << "  1-4: Switch views (Overview/Running/Pending/All)" << std::endl;
-        std::cerr << "  Up/Down: Scroll up/down" << std::endl;
-        std::cerr << "  Left/Right: Focus column" << std::endl;
-        std::cerr << "  PgUp/PgDn: Scroll by page" << std::endl;
-        std::cerr << "  R: Refresh" << std::endl;
-        std::cerr << "  Q: Quit" << std::endl;
+    double interval = 0; // Manual refresh only unless --interval is given
+    std::string backend = "auto";
+    bool serve = false;
+    std::string queueSocket = kDefaultQueueSocket;
+    uid_t queueSocketOwner = 0;
+    std::string statsPath;
+    int historyHours = 0;
+    int parseThreads = kDefaultParseThreads;
+    bool batch = false;
+    BatchFormat format = BatchFormat::JSON;
+    JobSelection selection;
+
+    static const struct option longOptions[] = {
+        {"interval", required_argument, nullptr, 'i'},
+        {"user", required_argument, nullptr, 'u'},
+        {"account", required_argument, nullptr, 'A'},
+        {"backend", required_argument, nullptr, 'b'},
+        {"batch", no_argument, nullptr, 'B'},
+        {"format", required_argument, nullptr, 'f'},
+        {"serve", no_argument, nullptr, 'S'},
+        {"socket", required_argument, nullptr, 's'},
+        {"socket-owner", required_argument, nullptr, 'O'},
+        {"stats", required_argument, nullptr, 'T'},
+        {"history", required_argument, nullptr, 'H'},
+        {"threads", required_argument, nullptr, 'j'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:u:A:b:h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 'i': {
+                char* end = nullptr;
+                interval = strtod(optarg, &end);
+                if (end == optarg || *end != '\0' || interval <= 0) {
+                    std::cerr << "Invalid interval: " << optarg << std::endl;
+                    return 1;
+                }
+                if (interval < kMinRefreshInterval) {
+                    std::cerr << "Interval raised to the minimum of " << kMinRefreshInterval << "s" << std::endl;
+                    interval = kMinRefreshInterval;
+                }
+                break;
+            }
+            case 'u':
+                if (!addNames(optarg, selection.users)) {
+                    std::cerr << "Invalid user list: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'A':
+                if (!addNames(optarg, selection.accounts)) {
+                    std::cerr << "Invalid account list: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'b':
+                backend = optarg;
+                break;
+            case 'B':
+                batch = true;
+                break;
+            case 'f':
+                if (!parseBatchFormat(optarg, format)) {
+                    std::cerr << "Unknown format: " << optarg << " (use json, csv or prometheus)" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'S':
+                serve = true;
+                break;
+            case 's':
+                queueSocket = optarg;
+                break;
+            case 'O': {
+                struct passwd* pw = getpwnam(optarg);
+                if (!pw) {
+                    std::cerr << "Unknown user: " << optarg << std::endl;
+                    return 1;
+                }
+                queueSocketOwner = pw->pw_uid;
+                break;
+            }
+            case 'T':
+                statsPath = optarg;
+                break;
+            case 'H': {
+                char* end = nullptr;
+                long hours = strtol(optarg, &end, 10);
+                long maxHours = kHistoryTiers[kHistoryTierCount - 1].seconds *
+                                (long)kHistoryTiers[kHistoryTierCount - 1].buckets / 3600;
+                if (end == optarg || *end != '\0' || hours <= 0 || hours > maxHours) {
+                    std::cerr << "Invalid history: " << optarg << " (1 to " << maxHours << " hours)" << std::endl;
+                    return 1;
+                }
+                historyHours = (int)hours;
+                break;
+            }
+            case 'j': {
+                char* end = nullptr;
+                long threads = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || threads < 1 || threads > kMaxParseThreads) {
+                    std::cerr << "Invalid thread count: " << optarg << " (1 to " << kMaxParseThreads << ")" << std::endl;
+                    return 1;
+                }
+                parseThreads = (int)threads;
+                break;
+            }
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (serve) return runServer(queueSocket, interval > 0 ? interval : kDefaultServeInterval, parseThreads);
+
+    for (int i = optind; i < argc; i++) {
+        if (!addNames(argv[i], selection.users)) {
+            std::cerr << "Invalid user name: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (selection.empty()) {
+        printUsage(argv[0]);
         return 1;
     }
 
     SlurmData data;
-    data.username = argv[1];
+    data.selection = selection;
 
-    // Initial data fetch
-    fetchSlurmData(data);
+    // Initial data fetch runs in the background while the UI comes up
+    std::unique_ptr<SlurmDataSource> source = createDataSource(backend, queueSocket, queueSocketOwner);
+    if (!source) {
+        std::cerr << "Unknown or unavailable backend: " << backend << std::endl;
+        return 1;
+    }
+    source->setParseThreads(parseThreads);
+
+    if (batch) return runBatch(data, *source, format, interval);
+
+    FILE* statsLog = nullptr;
+    if (!statsPath.empty()) {
+        statsLog = fopen(statsPath.c_str(), "a");
+        if (!statsLog) {
+            std::cerr << "Cannot open " << statsPath << ": " << strerror(errno) << std::endl;
+            return 1;
+        }
+        setvbuf(statsLog, nullptr, _IOLBF, 0); // Whole lines, readable with tail -f
+    }
+
+    // Show the data saved by the last run until the first fetch completes
+    DataFetcher fetcher(data.selection, *source, interval);
+    if (loadSnapshot(data)) fetcher.skipPartialSnapshots();
+    fetcher.setCapacityWanted(true); // The UI starts on the overview
+    fetcher.start();
+    fetcher.requestRefresh();
 
     // Run UI
-    SlurmTopUI ui(data);
-    ui.run();
+    {
+        SlurmTopUI ui(data, fetcher);
+        ui.setStatsLog(statsLog);
+        if (historyHours > 0) ui.seedHistory(data.selection, historyHours);
+        ui.run();
+        killRunningCommands(); // The helpers' threads would otherwise finish their queries first
+    }
+    if (statsLog) fclose(statsLog);
 
+    if (data.complete && !data.stale) saveSnapshot(data);
     return 0;
 }
+#endif